@@ -0,0 +1,233 @@
+// //////////////////////////////////////////////////////////
+// crc32c.cpp
+// CRC-32C (Castagnoli), reflected polynomial 0x82F63B78
+//
+
+#include "crc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+
+namespace
+{
+  /// reflected Castagnoli polynomial
+  const uint32_t Polynomial = 0x82F63B78;
+
+  /// lookup tables for slicing-by-8
+  struct Tables
+  {
+    uint32_t t[8][256];
+
+    Tables()
+    {
+      for (uint32_t i = 0; i < 256; i++)
+      {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++)
+          crc = (crc >> 1) ^ (Polynomial & (0 - (crc & 1)));
+        t[0][i] = crc;
+      }
+      for (uint32_t i = 0; i < 256; i++)
+        for (int slice = 1; slice < 8; slice++)
+          t[slice][i] = (t[slice - 1][i] >> 8) ^ t[0][t[slice - 1][i] & 0xFF];
+    }
+  };
+
+  const Tables& tables()
+  {
+    static const Tables instance;
+    return instance;
+  }
+
+  /// portable fallback, 8 bytes per iteration
+  uint32_t updateSoftware(uint32_t crc, const uint8_t* current, size_t numBytes)
+  {
+    const Tables& lut = tables();
+
+    // align to 8 bytes
+    while (numBytes > 0 && ((uintptr_t) current & 7) != 0)
+    {
+      crc = (crc >> 8) ^ lut.t[0][(crc ^ *current++) & 0xFF];
+      numBytes--;
+    }
+
+    while (numBytes >= 8)
+    {
+      uint32_t one, two;
+      memcpy(&one, current,     4);
+      memcpy(&two, current + 4, 4);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+      one = __builtin_bswap32(one);
+      two = __builtin_bswap32(two);
+#endif
+      one ^= crc;
+      crc = lut.t[7][ one        & 0xFF] ^
+            lut.t[6][(one >>  8) & 0xFF] ^
+            lut.t[5][(one >> 16) & 0xFF] ^
+            lut.t[4][ one >> 24        ] ^
+            lut.t[3][ two        & 0xFF] ^
+            lut.t[2][(two >>  8) & 0xFF] ^
+            lut.t[1][(two >> 16) & 0xFF] ^
+            lut.t[0][ two >> 24        ];
+      current  += 8;
+      numBytes -= 8;
+    }
+
+    while (numBytes-- > 0)
+      crc = (crc >> 8) ^ lut.t[0][(crc ^ *current++) & 0xFF];
+
+    return crc;
+  }
+
+#ifdef CRC32C_HAVE_SSE42
+  /// SSE4.2 crc32 instruction, 8 bytes per iteration
+  __attribute__((target("sse4.2")))
+  uint32_t updateHardware(uint32_t crc, const uint8_t* current, size_t numBytes)
+  {
+    while (numBytes > 0 && ((uintptr_t) current & 7) != 0)
+    {
+      crc = _mm_crc32_u8(crc, *current++);
+      numBytes--;
+    }
+
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while (numBytes >= 8)
+    {
+      uint64_t chunk;
+      memcpy(&chunk, current, 8);
+      crc64 = _mm_crc32_u64(crc64, chunk);
+      current  += 8;
+      numBytes -= 8;
+    }
+    crc = (uint32_t) crc64;
+#endif
+
+    while (numBytes >= 4)
+    {
+      uint32_t chunk;
+      memcpy(&chunk, current, 4);
+      crc = _mm_crc32_u32(crc, chunk);
+      current  += 4;
+      numBytes -= 4;
+    }
+
+    while (numBytes-- > 0)
+      crc = _mm_crc32_u8(crc, *current++);
+
+    return crc;
+  }
+#endif
+
+  typedef uint32_t (*UpdateFunction)(uint32_t, const uint8_t*, size_t);
+
+  /// pick the best implementation
+  UpdateFunction selectUpdate()
+  {
+#if defined(CRC32C_HAVE_SSE42) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("sse4.2"))
+      return updateHardware;
+#endif
+    return updateSoftware;
+  }
+
+  /// the implementation picked on first use; a namespace-scope pointer
+  /// might still be null when another file's static initializer hashes
+  UpdateFunction selected()
+  {
+    static const UpdateFunction best = selectUpdate();
+    return best;
+  }
+
+  uint32_t update(uint32_t crc, const uint8_t* data, size_t numBytes)
+  {
+    return selected()(crc, data, numBytes);
+  }
+}
+
+
+/// same as reset()
+CRC32C::CRC32C()
+{
+  reset();
+}
+
+
+/// restart
+void CRC32C::reset()
+{
+  m_hash = 0xFFFFFFFF;
+}
+
+
+/// true if the hardware crc32 instruction is used
+bool CRC32C::hardwareAccelerated()
+{
+#ifdef CRC32C_HAVE_SSE42
+  return selected() == updateHardware;
+#else
+  return false;
+#endif
+}
+
+
+/// add arbitrary number of bytes
+void CRC32C::add(const void* data, size_t numBytes)
+{
+  m_hash = update(m_hash, (const uint8_t*) data, numBytes);
+}
+
+
+/// return latest hash as 8 hex characters
+std::string CRC32C::getHash()
+{
+  // compute hash (as raw bytes)
+  unsigned char rawHash[HashBytes];
+  getHash(rawHash);
+
+  // convert to hex string
+  std::string result;
+  result.reserve(2 * HashBytes);
+  for (int i = 0; i < HashBytes; i++)
+  {
+    static const char dec2hex[16+1] = "0123456789abcdef";
+    result += dec2hex[(rawHash[i] >> 4) & 15];
+    result += dec2hex[ rawHash[i]       & 15];
+  }
+
+  return result;
+}
+
+
+/// return latest hash as bytes (big endian)
+void CRC32C::getHash(unsigned char buffer[CRC32C::HashBytes])
+{
+  uint32_t crc = ~m_hash;
+  buffer[0] = (crc >> 24) & 0xFF;
+  buffer[1] = (crc >> 16) & 0xFF;
+  buffer[2] = (crc >>  8) & 0xFF;
+  buffer[3] =  crc        & 0xFF;
+}
+
+
+/// compute CRC32C of a memory block
+std::string CRC32C::operator()(const void* data, size_t numBytes)
+{
+  reset();
+  add(data, numBytes);
+  return getHash();
+}
+
+
+/// compute CRC32C of a string, excluding final zero
+std::string CRC32C::operator()(const std::string& text)
+{
+  reset();
+  add(text.c_str(), text.size());
+  return getHash();
+}
@@ -0,0 +1,70 @@
+// //////////////////////////////////////////////////////////
+// crc32c.h
+// CRC-32C (Castagnoli) checksum, same interface as sha256.h
+//
+// Not a cryptographic hash: only meant as a cheap first-pass
+// check before escalating to SHA-256.
+#pragma once
+
+#include <string>
+
+// define fixed size integer types
+#ifdef _MSC_VER
+// Windows
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int32 uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+// GCC
+#include <stdint.h>
+#endif
+
+
+/// compute CRC-32C checksum
+/** Usage:
+    CRC32C crc32c;
+    std::string myHash  = crc32c("Hello World");     // std::string
+    std::string myHash2 = crc32c("How are you", 11); // arbitrary data, 11 bytes
+
+    // or in a streaming fashion:
+
+    CRC32C crc32c;
+    while (more data available)
+      crc32c.add(pointer to fresh data, number of new bytes);
+    std::string myHash3 = crc32c.getHash();
+
+    Uses the SSE4.2 crc32 instruction when the CPU supports it,
+    a slicing-by-8 table otherwise.
+  */
+class CRC32C
+{
+public:
+  /// hash is 4 bytes long
+  enum { HashBytes = 4 };
+
+  /// same as reset()
+  CRC32C();
+
+  /// compute CRC32C of a memory block
+  std::string operator()(const void* data, size_t numBytes);
+  /// compute CRC32C of a string, excluding final zero
+  std::string operator()(const std::string& text);
+
+  /// add arbitrary number of bytes
+  void add(const void* data, size_t numBytes);
+
+  /// return latest hash as 8 hex characters
+  std::string getHash();
+  /// return latest hash as bytes (big endian)
+  void        getHash(unsigned char buffer[HashBytes]);
+
+  /// restart
+  void reset();
+
+  /// true if the hardware crc32 instruction is used
+  static bool hardwareAccelerated();
+
+private:
+  /// hash, stored with the final inversion not yet applied
+  uint32_t m_hash;
+};
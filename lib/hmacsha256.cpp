@@ -0,0 +1,94 @@
+// //////////////////////////////////////////////////////////
+// hmacsha256.cpp
+// HMAC-SHA256 with precomputed inner and outer hashes, see hmacsha256.h
+//
+
+#include "hmacsha256.h"
+
+#include <string.h>
+
+
+/// hash both padded key blocks once
+HMACSHA256::Key::Key(const void* key, size_t numBytes)
+{
+  unsigned char block[BlockSize];
+  memset(block, 0, sizeof(block));
+  if (numBytes > BlockSize)
+  {
+    SHA256 shortened;
+    shortened.add(key, numBytes);
+    shortened.getHash(block);
+  }
+  else if (numBytes > 0)
+    memcpy(block, key, numBytes);
+
+  unsigned char pad[BlockSize];
+  for (int i = 0; i < BlockSize; i++)
+    pad[i] = block[i] ^ 0x36;
+  m_inner.add(pad, BlockSize);
+
+  for (int i = 0; i < BlockSize; i++)
+    pad[i] = block[i] ^ 0x5c;
+  m_outer.add(pad, BlockSize);
+}
+
+
+/// the empty key, shared by all default constructed instances
+HMACSHA256::HMACSHA256()
+{
+  static const Key emptyKey(NULL, 0);
+  m_key = &emptyKey;
+  reset();
+}
+
+
+HMACSHA256::HMACSHA256(const Key& key)
+: m_key(&key)
+{
+  reset();
+}
+
+
+/// restart with the same key
+void HMACSHA256::reset()
+{
+  m_inner = m_key->m_inner;
+}
+
+
+/// add arbitrary number of bytes
+void HMACSHA256::add(const void* data, size_t numBytes)
+{
+  m_inner.add(data, numBytes);
+}
+
+
+/// return latest MAC as bytes
+void HMACSHA256::getHash(unsigned char buffer[HMACSHA256::HashBytes])
+{
+  unsigned char innerHash[HashBytes];
+  m_inner.getHash(innerHash);
+
+  SHA256 outer = m_key->m_outer;
+  outer.add(innerHash, HashBytes);
+  outer.getHash(buffer);
+}
+
+
+/// return latest MAC as 64 hex characters
+std::string HMACSHA256::getHash()
+{
+  unsigned char rawHash[HashBytes];
+  getHash(rawHash);
+
+  std::string result;
+  result.reserve(2 * HashBytes);
+  for (int i = 0; i < HashBytes; i++)
+  {
+    static const char dec2hex[16+1] = "0123456789abcdef";
+    result += dec2hex[(rawHash[i] >> 4) & 15];
+    result += dec2hex[ rawHash[i]       & 15];
+  }
+
+  return result;
+}
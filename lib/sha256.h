@@ -25,11 +25,14 @@
   */
 
 // Thanks, Stephen!
-// 
+//
+// Modified for itfl: the Hash base class is gone. itfl plugs digest engines
+// into its readers as template parameters, so SHA256 only has to provide
+// the same member functions (see src/hasher.h), no virtual calls.
+//
 // Check his library out here: https://create.stephan-brumme.com/hash-library/
 #pragma once
 
-//#include "hash.h"
 #include <string>
 
 // define fixed size integer types
@@ -57,7 +60,7 @@ typedef unsigned __int64 uint64_t;
       sha256.add(pointer to fresh data, number of new bytes);
     std::string myHash3 = sha256.getHash();
   */
-class SHA256 //: public Hash
+class SHA256
 {
 public:
   /// split into 64 byte blocks (=> 512 bits), hash is 32 bytes long
@@ -0,0 +1,314 @@
+// //////////////////////////////////////////////////////////
+// sha256fixed.h
+// SHA-256 for inputs whose length is known at compile time
+//
+// Written for itfl next to Stephan Brumme's sha256.h: same round
+// functions, but everything is constexpr and the message length is a
+// template parameter. The padding words are computed by the compiler:
+// hashing a digest only assembles words 0..7 of its single block, the
+// second block of a tree node only its first word, and for 64 byte inputs
+// the whole expanded schedule of the padding block is a constant. Words
+// are built straight from the input, so there is no buffering and no
+// copy into a message array.
+#pragma once
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace sha256fixed
+{
+  enum { BlockSize = 512 / 8, HashBytes = 32 };
+
+  /// first byte hashed into a Merkle leaf and into an inner node, as in
+  /// RFC 6962, so that no node can be passed off as a leaf or vice versa
+  enum { LeafPrefix = 0x00, NodePrefix = 0x01 };
+
+  typedef std::array<uint8_t, HashBytes> Digest;
+
+  namespace detail
+  {
+    constexpr uint32_t K[64] =
+    {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    /// initial hash values, same as SHA256::reset()
+    constexpr uint32_t Init[8] =
+    {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    struct State    { uint32_t h[8];  };
+    struct Block    { uint32_t w[16]; };
+    /// message schedule with the round constants already added
+    struct Schedule { uint32_t wk[64]; };
+
+    constexpr uint32_t rotate(uint32_t a, uint32_t c)
+    {
+      return (a >> c) | (a << (32 - c));
+    }
+
+    constexpr uint32_t load(const uint8_t* p)
+    {
+      return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    constexpr Schedule expand(const Block& block)
+    {
+      uint32_t w[64] = {};
+      for (int i = 0; i < 16; i++)
+        w[i] = block.w[i];
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 48
+#endif
+      for (int i = 16; i < 64; i++)
+        w[i] = w[i-16] +
+               (rotate(w[i-15],  7) ^ rotate(w[i-15], 18) ^ (w[i-15] >>  3)) +
+               w[i-7] +
+               (rotate(w[i- 2], 17) ^ rotate(w[i- 2], 19) ^ (w[i- 2] >> 10));
+
+      Schedule schedule = {};
+      for (int i = 0; i < 64; i++)
+        schedule.wk[i] = w[i] + K[i];
+      return schedule;
+    }
+
+    /// 64 rounds on an expanded schedule
+    constexpr void compress(State& state, const Schedule& schedule)
+    {
+      uint32_t a = state.h[0], b = state.h[1], c = state.h[2], d = state.h[3];
+      uint32_t e = state.h[4], f = state.h[5], g = state.h[6], h = state.h[7];
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 64
+#endif
+      for (int i = 0; i < 64; i++)
+      {
+        uint32_t t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + schedule.wk[i];
+        uint32_t t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+      }
+
+      state.h[0] += a; state.h[1] += b; state.h[2] += c; state.h[3] += d;
+      state.h[4] += e; state.h[5] += f; state.h[6] += g; state.h[7] += h;
+    }
+
+    constexpr State initialState()
+    {
+      State state = {};
+      for (int i = 0; i < 8; i++)
+        state.h[i] = Init[i];
+      return state;
+    }
+
+    constexpr size_t numBlocks(size_t numBytes)
+    {
+      // data, one 0x80 byte, 64 bit length, rounded up to full blocks
+      return (numBytes + 1 + 8 + BlockSize - 1) / BlockSize;
+    }
+
+    /// block 'index' of the padding of a NumBytes message, with every message
+    /// byte taken as zero: the 0x80 byte and the bit length
+    template <size_t NumBytes>
+    constexpr Block paddingBlock(size_t index)
+    {
+      Block block = {};
+      for (size_t word = 0; word < 16; word++)
+      {
+        uint32_t value = 0;
+        for (size_t byte = 0; byte < 4; byte++)
+        {
+          size_t pos = index * BlockSize + word * 4 + byte;
+          uint8_t c = 0;
+          if (pos == NumBytes)
+            c = 0x80;
+          else if (pos >= numBlocks(NumBytes) * BlockSize - 8)
+            c = uint8_t((uint64_t(NumBytes) * 8) >> (8 * (numBlocks(NumBytes) * BlockSize - 1 - pos)));
+          value = (value << 8) | c;
+        }
+        block.w[word] = value;
+      }
+      return block;
+    }
+
+    /// padding words of each block, evaluated by the compiler
+    template <size_t NumBytes, size_t Index>
+    struct PaddingWords
+    {
+      static constexpr Block value = paddingBlock<NumBytes>(Index);
+    };
+
+    template <size_t NumBytes, size_t Index>
+    constexpr Block PaddingWords<NumBytes, Index>::value;
+
+    /// words of block 'index' that carry message bytes; the ones after them
+    /// are pure padding and come from PaddingWords as they are. A 32 byte
+    /// input has 8 of 16, the second block of a 65 byte tree node just 1.
+    template <size_t NumBytes>
+    constexpr size_t messageWords(size_t index)
+    {
+      if (index * BlockSize >= NumBytes)
+        return 0;
+      size_t bytes = NumBytes - index * BlockSize;
+      return bytes >= BlockSize ? 16 : (bytes + 3) / 4;
+    }
+
+    /// true if block 'index' of a NumBytes message holds no message bytes at all,
+    /// e.g. the second block of a 64 byte input
+    template <size_t NumBytes>
+    constexpr bool isPaddingOnly(size_t index)
+    {
+      return messageWords<NumBytes>(index) == 0;
+    }
+
+    /// block 'Index' of the padded message whose byte 'pos' is bytes(pos):
+    /// only the words that carry message bytes are assembled, the rest is
+    /// the precomputed padding
+    template <size_t NumBytes, size_t Index, typename Bytes>
+    constexpr Block messageBlock(const Bytes& bytes)
+    {
+      Block block = PaddingWords<NumBytes, Index>::value;
+      for (size_t word = 0; word < messageWords<NumBytes>(Index); word++)
+      {
+        uint32_t value = 0;
+        for (size_t byte = 0; byte < 4; byte++)
+        {
+          size_t pos = Index * BlockSize + word * 4 + byte;
+          value = (value << 8) | (pos < NumBytes ? uint8_t(bytes(pos)) : 0);
+        }
+        block.w[word] |= value;
+      }
+      return block;
+    }
+
+    /// expanded schedule of the trailing padding-only block, evaluated by the compiler
+    template <size_t NumBytes>
+    struct PaddingSchedule
+    {
+      static constexpr Schedule value = expand(PaddingWords<NumBytes, numBlocks(NumBytes) - 1>::value);
+    };
+
+    template <size_t NumBytes>
+    constexpr Schedule PaddingSchedule<NumBytes>::value;
+
+    /// compress blocks Index and up of the message
+    template <size_t NumBytes, size_t Index, typename Bytes>
+    constexpr void compressFrom(State& state, const Bytes& bytes)
+    {
+      if constexpr (Index < numBlocks(NumBytes))
+      {
+        // a block of nothing but padding is fully precomputed
+        if constexpr (isPaddingOnly<NumBytes>(Index))
+          compress(state, PaddingSchedule<NumBytes>::value);
+        else
+          compress(state, expand(messageBlock<NumBytes, Index>(bytes)));
+        compressFrom<NumBytes, Index + 1>(state, bytes);
+      }
+    }
+
+    constexpr Digest store(const State& state)
+    {
+      Digest digest = {};
+      for (int i = 0; i < 8; i++)
+      {
+        digest[4*i    ] = uint8_t(state.h[i] >> 24);
+        digest[4*i + 1] = uint8_t(state.h[i] >> 16);
+        digest[4*i + 2] = uint8_t(state.h[i] >>  8);
+        digest[4*i + 3] = uint8_t(state.h[i]);
+      }
+      return digest;
+    }
+
+    /// SHA256 of the NumBytes bytes bytes(0) .. bytes(NumBytes - 1)
+    template <size_t NumBytes, typename Bytes>
+    constexpr Digest hashBytes(const Bytes& bytes)
+    {
+      State state = initialState();
+      compressFrom<NumBytes, 0>(state, bytes);
+      return store(state);
+    }
+  }
+
+
+  /// SHA256 of exactly NumBytes bytes
+  template <size_t NumBytes>
+  constexpr Digest hash(const uint8_t* data)
+  {
+    return detail::hashBytes<NumBytes>([data](size_t pos) { return data[pos]; });
+  }
+
+  /// SHA256 of a fixed size array
+  template <size_t NumBytes>
+  constexpr Digest hash(const std::array<uint8_t, NumBytes>& data)
+  {
+    return hash<NumBytes>(data.data());
+  }
+
+  /// SHA256(SHA256(data)), the digest-of-digest used by tree and manifest roots
+  template <size_t NumBytes>
+  constexpr Digest doubleHash(const uint8_t* data)
+  {
+    Digest inner = hash<NumBytes>(data);
+    return hash<HashBytes>(inner.data());
+  }
+
+  /// SHA256(0x01 || left || right), a Merkle tree node.
+  /// Two blocks; the second holds the last byte of 'right' and the padding.
+  /// The words are assembled straight from the two digests, without
+  /// copying them into a node buffer first.
+  constexpr Digest combine(const Digest& left, const Digest& right)
+  {
+    return detail::hashBytes<1 + 2 * HashBytes>([&left, &right](size_t pos)
+    {
+      return pos == 0 ? uint8_t(NodePrefix) : pos <= HashBytes ? left[pos - 1] : right[pos - 1 - HashBytes];
+    });
+  }
+
+
+  // known answers, checked by the compiler wherever this header is included
+  namespace detail
+  {
+    constexpr bool equals(const Digest& digest, const char* hex)
+    {
+      for (int i = 0; i < HashBytes; i++)
+      {
+        int hi = hex[2*i]   <= '9' ? hex[2*i]   - '0' : hex[2*i]   - 'a' + 10;
+        int lo = hex[2*i+1] <= '9' ? hex[2*i+1] - '0' : hex[2*i+1] - 'a' + 10;
+        if (digest[i] != uint8_t(hi * 16 + lo))
+          return false;
+      }
+      return true;
+    }
+
+    constexpr uint8_t Abc[3] = { 'a', 'b', 'c' };
+    constexpr Digest  Zero   = {};
+    constexpr uint8_t Zero64[2 * HashBytes] = {};
+
+    static_assert(equals(hash<0>(nullptr),
+                  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"), "SHA256 of empty input");
+    static_assert(equals(hash<3>(Abc),
+                  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"), "SHA256 of 'abc'");
+    static_assert(equals(hash<HashBytes>(Zero.data()),
+                  "66687aadf862bd776c8fc18b8e9f8e20089714856ee233b3902a591d0d5f2925"), "SHA256 of 32 zero bytes");
+    static_assert(equals(hash<2 * HashBytes>(Zero64),
+                  "f5a5fd42d16a20302798ef6ed309979b43003d2320d9f0e8ea9831a92759fb4b"), "SHA256 of 64 zero bytes");
+    static_assert(equals(combine(Zero, Zero),
+                  "ae0798d0ecaed2b778eddebf18f071a561c53658c05e76cedecc27cafbdbc577"), "SHA256 of 0x01 and 64 zero bytes");
+    // the fixed-size inputs the tree and sha256d hash do take the precomputed words
+    static_assert(messageWords<HashBytes>(0) == 8, "32 byte inputs: words 8..15 precomputed");
+    static_assert(messageWords<1 + 2 * HashBytes>(1) == 1, "tree nodes: words 1..15 of the second block precomputed");
+    static_assert(isPaddingOnly<2 * HashBytes>(1), "64 byte inputs: whole second schedule precomputed");
+    static_assert(equals(doubleHash<3>(Abc),
+                  "4f8b42c22dd3729b519ba6f68d2da7cc5b2d606d05daed5ad5128cc03e6c6358"), "double SHA256 of 'abc'");
+  }
+}
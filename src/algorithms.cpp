@@ -0,0 +1,87 @@
+#include "algorithms.h"
+
+#include "../lib/crc32c.h"
+#include "../lib/sha256.h"
+#include "../lib/sha256fixed.h"
+#include "hasher.h"
+#include "hex.h"
+#include "tree.h"
+
+#include <algorithm>
+
+namespace {
+
+// SHA256(SHA256(file)). The outer hash always sees exactly 32 bytes, so it
+// goes through the fixed-length path.
+class DoubleSHA256 {
+    public:
+    enum { HashBytes = SHA256::HashBytes };
+
+    void reset() { inner.reset(); }
+    void add(const void* data, size_t numBytes) { inner.add(data, numBytes); }
+
+    void getHash(unsigned char buffer[HashBytes]) {
+        unsigned char digest[HashBytes];
+        inner.getHash(digest);
+        sha256fixed::Digest outer = sha256fixed::hash<HashBytes>(digest);
+        std::copy(outer.begin(), outer.end(), buffer);
+    }
+
+    std::string getHash() {
+        unsigned char digest[HashBytes];
+        getHash(digest);
+        return toHex(digest, HashBytes);
+    }
+
+    private:
+    SHA256 inner;
+};
+
+template <typename H>
+bool hashFileWith(const std::string& filename, const ReadContext& ctx, std::string& hex) {
+    static_assert(is_hasher_v<H>, "algorithm table entries must be Hashers");
+    H hasher;
+    if (!hashFile(filename, ctx, hasher)) return false;
+
+    std::uint64_t start = ctx.stats ? nowNs() : 0;
+    hex = hasher.getHash();
+    if (ctx.stats) ctx.stats->finalizeNs += nowNs() - start;
+    return true;
+}
+
+template <typename H>
+std::string hashMemoryWith(const void* data, std::size_t size) {
+    H hasher;
+    hasher.add(data, size);
+    return hasher.getHash();
+}
+
+#define ITFL_ALGORITHM(name, H) {name, H::HashBytes, hashFileWith<H>, hashMemoryWith<H>, false}
+
+const Algorithm algorithms[] = {
+    ITFL_ALGORITHM("sha256", SHA256),
+    ITFL_ALGORITHM("sha256d", DoubleSHA256),
+    ITFL_ALGORITHM("crc32c", CRC32C),
+    // Not a streaming Hasher: reads its chunks itself, in parallel when it can
+    {"sha256tree", SHA256::HashBytes, treeHashFile, treeHashMemory, true},
+};
+
+#undef ITFL_ALGORITHM
+
+} // namespace
+
+const Algorithm* findAlgorithm(const std::string& name) {
+    for (const Algorithm& algorithm : algorithms) {
+        if (name == algorithm.name) return &algorithm;
+    }
+    return nullptr;
+}
+
+std::string algorithmNames() {
+    std::string names;
+    for (const Algorithm& algorithm : algorithms) {
+        if (!names.empty()) names += ", ";
+        names += algorithm.name;
+    }
+    return names;
+}
@@ -0,0 +1,26 @@
+// The one place that maps an algorithm name from the command line to a
+// concrete Hasher type. Adding an algorithm means adding a row to the table
+// in algorithms.cpp; every backend in reader.h works with it unchanged.
+#pragma once
+
+#include "reader.h"
+
+#include <cstddef>
+#include <string>
+
+struct Algorithm {
+    const char* name;
+    std::size_t hashBytes;
+    // Hash a whole file into a hex digest. Returns false if it could not be read.
+    bool (*hashFile)(const std::string& filename, const ReadContext& ctx, std::string& hex);
+    // Hash a block of memory into a hex digest
+    std::string (*hashMemory)(const void* data, std::size_t size);
+    // Splits one file over ReadContext::pool when given one
+    bool splitsFiles;
+};
+
+// nullptr if there is no algorithm by that name
+const Algorithm* findAlgorithm(const std::string& name);
+
+// Comma separated list of known names, for --help
+std::string algorithmNames();
@@ -0,0 +1,22 @@
+// The ways itfl can read a file
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+enum class Backend {
+    Stream,  // std::ifstream, portable
+    Read,    // open() + read() loop
+    Pread,   // pread() up to the size from fstat, no probing read for EOF
+    Mmap,    // map the whole file and hash it in place
+    Direct,  // O_DIRECT reads, bypassing the page cache
+    Sparse,  // pread() only the data extents, holes are hashed as zeros
+    Pipelined, // read() on a helper thread while the caller hashes
+    Auto,    // pick one of the above per file, see chooseBackend()
+};
+
+constexpr std::size_t BackendCount = static_cast<std::size_t>(Backend::Auto) + 1;
+
+const char* backendName(Backend backend);
+// Accepts the names returned by backendName(). Returns false on anything else.
+bool parseBackend(const std::string& name, Backend& backend);
@@ -0,0 +1,91 @@
+// itfl bench: in-memory hashing throughput per worker, to see what thread
+// placement and buffer locality are worth on this host
+#include "../lib/cxxopts.hpp"
+#include "algorithms.h"
+#include "commands.h"
+#include "options.h"
+#include "pool.h"
+#include "term.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+int runBench(int argc, char* argv[]) {
+    cxxopts::Options options("itfl bench", "Measure hashing throughput from memory\n\nUsage:\n itfl bench [OPTIONS]");
+    options.add_options()
+        ("a,algorithm", "Digest algorithm: " + algorithmNames(), cxxopts::value<std::string>()->default_value("sha256"))
+        ("size", "Buffer per worker (K, M, G suffixes)", cxxopts::value<std::string>()->default_value("64M"))
+        ("rounds", "Passes over each buffer", cxxopts::value<unsigned>()->default_value("4"))
+        ("naive", "Do not pin workers, allocate every buffer from the main thread")
+        ("help", "Print usage");
+    addCommonOptions(options);
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+
+    const Algorithm* algorithm = findAlgorithm(result["algorithm"].as<std::string>());
+    if (algorithm == nullptr) {
+        std::cerr << color.red << "Error: " << color.reset << "Unknown algorithm, expected one of: " << algorithmNames() << "\n";
+        return 1;
+    }
+    std::uint64_t size = 0;
+    if (!parseSize(result["size"].as<std::string>(), size) || size == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "Invalid --size\n";
+        return 1;
+    }
+    const unsigned rounds = result["rounds"].as<unsigned>();
+    const bool naive = result.count("naive");
+
+    WorkerPool pool(common.jobs, common.topology, !naive);
+    std::vector<std::unique_ptr<char[]>> buffers(pool.size());
+
+    // Naive: every page is touched by the main thread and lands on its node.
+    // Placed: each worker touches its own buffer after pinning.
+    auto allocate = [&](std::size_t index) {
+        buffers[index].reset(new char[size]);
+        std::memset(buffers[index].get(), static_cast<int>(index + 1), size);
+    };
+    if (naive) {
+        for (std::size_t i = 0; i < pool.size(); i++) allocate(i);
+    } else {
+        pool.forEachWorker([&](Worker& worker) { allocate(worker.index); });
+    }
+
+    std::vector<std::uint64_t> elapsed(pool.size());
+    const RunTimer timer;
+    pool.forEachWorker([&](Worker& worker) {
+        std::uint64_t start = nowNs();
+        for (unsigned round = 0; round < rounds; round++) {
+            algorithm->hashMemory(buffers[worker.index].get(), size);
+        }
+        elapsed[worker.index] = nowNs() - start;
+    });
+    std::uint64_t wallNs = timer.elapsedNs();
+
+    std::cout << "algorithm " << algorithm->name << ", " << pool.size() << " worker(s), "
+              << common.topology.nodeCount() << " node(s), " << (naive ? "naive" : "placed") << '\n';
+    std::cout << std::fixed << std::setprecision(1);
+    double perWorker = static_cast<double>(size) * rounds / 1e6;
+    for (std::size_t i = 0; i < pool.size(); i++) {
+        const Worker& worker = pool.worker(i);
+        std::cout << "worker " << i << ": cpu " << worker.cpu << " node " << worker.node
+                  << (worker.cpu >= 0 && !worker.pinned ? " (not pinned)" : "") << "  "
+                  << perWorker / (static_cast<double>(elapsed[i]) / 1e9) << " MB/s\n";
+    }
+    std::cout << "total: " << perWorker * pool.size() / (static_cast<double>(wallNs) / 1e9) << " MB/s\n";
+    return 0;
+}
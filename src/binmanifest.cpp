@@ -0,0 +1,235 @@
+#include "binmanifest.h"
+
+#include "../lib/sha256.h"
+#include "hex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const char Magic[8] = {'I', 'T', 'F', 'L', 'M', 'A', 'N', 1};
+
+struct Header {
+    char magic[8];
+    std::uint64_t count;
+    std::uint64_t stringBytes;
+    std::uint64_t reserved;
+};
+
+enum RecordFlags : std::uint32_t { HasSha256 = 1, HasCrc32c = 2, HasStat = 4, BinaryMode = 8 };
+
+} // namespace
+
+struct ManifestRecord {
+    unsigned char sha256[SHA256::HashBytes];
+    std::uint64_t size;
+    std::int64_t mtimeNs;
+    std::uint64_t pathOffset;
+    std::uint32_t pathLength;
+    std::uint32_t crc32c;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(Header) == 32, "manifest header layout");
+static_assert(sizeof(ManifestRecord) == 72, "manifest record layout");
+
+bool isBinaryManifest(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(Magic)];
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+BinaryManifestBuilder::BinaryManifestBuilder() = default;
+BinaryManifestBuilder::~BinaryManifestBuilder() = default;
+
+void BinaryManifestBuilder::reserve(std::size_t entries) {
+    records.reserve(entries);
+}
+
+void BinaryManifestBuilder::add(const RawManifestEntry& entry) {
+    if (records.size() == UINT32_MAX) throw std::runtime_error("too many entries for a binary manifest");
+    if (entry.path.size() > UINT32_MAX) throw std::runtime_error("path too long for a binary manifest");
+
+    ManifestRecord record;
+    std::memset(&record, 0, sizeof(record));
+    if (entry.sha256) {
+        std::memcpy(record.sha256, entry.sha256, sizeof(record.sha256));
+        record.flags |= HasSha256;
+    }
+    if (entry.crc32c) {
+        const unsigned char* crc = entry.crc32c;
+        record.crc32c = std::uint32_t(crc[0]) << 24 | std::uint32_t(crc[1]) << 16 | std::uint32_t(crc[2]) << 8 | crc[3];
+        record.flags |= HasCrc32c;
+    }
+    if (entry.hasStat) {
+        record.size = entry.size;
+        record.mtimeNs = entry.mtimeNs;
+        record.flags |= HasStat;
+    }
+    if (entry.binaryMode) record.flags |= BinaryMode;
+    record.pathOffset = strings.size();
+    record.pathLength = static_cast<std::uint32_t>(entry.path.size());
+    strings += entry.path;
+    records.push_back(record);
+}
+
+void BinaryManifestBuilder::write(const std::string& filename) const {
+    auto pathOf = [&](std::uint32_t i) { return std::string_view(strings.data() + records[i].pathOffset, records[i].pathLength); };
+
+    // Ties keep the order they were written in, so find() returns them that way
+    std::vector<std::uint32_t> index(records.size());
+    for (std::size_t i = 0; i < index.size(); i++) index[i] = static_cast<std::uint32_t>(i);
+    std::stable_sort(index.begin(), index.end(), [&](std::uint32_t a, std::uint32_t b) { return pathOf(a) < pathOf(b); });
+
+    Header header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.count = records.size();
+    header.stringBytes = strings.size();
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(ManifestRecord)));
+    out.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(std::uint32_t)));
+    out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    out.close();
+    if (!out) throw std::runtime_error("could not write manifest '" + filename + "'");
+}
+
+void writeBinaryManifest(const std::string& filename, const std::vector<ManifestEntry>& entries) {
+    BinaryManifestBuilder builder;
+    builder.reserve(entries.size());
+    for (const ManifestEntry& entry : entries) {
+        unsigned char sha256[SHA256::HashBytes], crc32c[4];
+        RawManifestEntry raw;
+        raw.path = entry.path;
+        if (!entry.sha256.empty()) {
+            if (!fromHex(entry.sha256, sha256, sizeof(sha256))) throw std::runtime_error("not a SHA-256 digest: '" + entry.sha256 + "'");
+            raw.sha256 = sha256;
+        }
+        if (!entry.crc32c.empty()) {
+            if (!fromHex(entry.crc32c, crc32c, sizeof(crc32c))) throw std::runtime_error("not a CRC-32C: '" + entry.crc32c + "'");
+            raw.crc32c = crc32c;
+        }
+        raw.hasStat = entry.hasStat;
+        raw.size = entry.size;
+        raw.mtimeNs = entry.mtimeNs;
+        raw.binaryMode = entry.binaryMode;
+        builder.add(raw);
+    }
+    builder.write(filename);
+}
+
+BinaryManifest::BinaryManifest(const std::string& filename) : file(filename, "manifest") {
+    Header header = {};
+    bool valid = file.size() >= sizeof(Header);
+    if (valid) {
+        std::memcpy(&header, file.data(), sizeof(header));
+        std::uint64_t rest = file.size() - sizeof(Header);
+        valid = std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 && header.count <= UINT32_MAX
+             && header.stringBytes <= rest && header.count * (sizeof(ManifestRecord) + sizeof(std::uint32_t)) == rest - header.stringBytes;
+    }
+    if (!valid) throw std::runtime_error("'" + filename + "' is not a binary manifest");
+
+    const unsigned char* data = file.data() + sizeof(Header);
+    count = static_cast<std::size_t>(header.count);
+    stringBytes = header.stringBytes;
+    records = reinterpret_cast<const ManifestRecord*>(data);
+    index = reinterpret_cast<const std::uint32_t*>(data + count * sizeof(ManifestRecord));
+    strings = reinterpret_cast<const char*>(data + count * (sizeof(ManifestRecord) + sizeof(std::uint32_t)));
+}
+
+// Records are only checked when they are used, so opening stays O(1)
+const ManifestRecord& BinaryManifest::record(std::size_t i) const {
+    const ManifestRecord& r = records[i];
+    if (r.pathOffset > stringBytes || r.pathLength > stringBytes - r.pathOffset) throw std::runtime_error("binary manifest is corrupt");
+    return r;
+}
+
+std::string_view BinaryManifest::path(std::size_t i) const {
+    const ManifestRecord& r = record(i);
+    return std::string_view(strings + r.pathOffset, r.pathLength);
+}
+
+const unsigned char* BinaryManifest::sha256(std::size_t i) const {
+    const ManifestRecord& r = record(i);
+    return (r.flags & HasSha256) ? r.sha256 : nullptr;
+}
+
+ManifestEntry BinaryManifest::entry(std::size_t i) const {
+    const ManifestRecord& r = record(i);
+    ManifestEntry entry;
+    entry.path.assign(strings + r.pathOffset, r.pathLength);
+    if (r.flags & HasSha256) entry.sha256 = toHex(r.sha256, sizeof(r.sha256));
+    if (r.flags & HasCrc32c) {
+        char crc[9];
+        std::snprintf(crc, sizeof(crc), "%08x", static_cast<unsigned>(r.crc32c));
+        entry.crc32c = crc;
+    }
+    if (r.flags & HasStat) {
+        entry.hasStat = true;
+        entry.size = r.size;
+        entry.mtimeNs = r.mtimeNs;
+    }
+    entry.binaryMode = (r.flags & BinaryMode) != 0;
+    return entry;
+}
+
+RawManifestEntry BinaryManifest::raw(std::size_t i, unsigned char (&crc32c)[4]) const {
+    const ManifestRecord& r = record(i);
+    RawManifestEntry entry;
+    entry.path = std::string_view(strings + r.pathOffset, r.pathLength);
+    if (r.flags & HasSha256) entry.sha256 = r.sha256;
+    if (r.flags & HasCrc32c) {
+        crc32c[0] = static_cast<unsigned char>(r.crc32c >> 24);
+        crc32c[1] = static_cast<unsigned char>(r.crc32c >> 16);
+        crc32c[2] = static_cast<unsigned char>(r.crc32c >> 8);
+        crc32c[3] = static_cast<unsigned char>(r.crc32c);
+        entry.crc32c = crc32c;
+    }
+    if (r.flags & HasStat) {
+        entry.hasStat = true;
+        entry.size = r.size;
+        entry.mtimeNs = r.mtimeNs;
+    }
+    entry.binaryMode = (r.flags & BinaryMode) != 0;
+    return entry;
+}
+
+std::size_t BinaryManifest::sorted(std::size_t k) const {
+    if (index[k] >= count) throw std::runtime_error("binary manifest is corrupt");
+    return index[k];
+}
+
+std::vector<std::size_t> BinaryManifest::find(std::string_view wanted) const {
+    // First position in the index whose path is not less than 'wanted'
+    std::size_t low = 0, high = count;
+    while (low < high) {
+        std::size_t middle = low + (high - low) / 2;
+        if (path(sorted(middle)) < wanted) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    std::vector<std::size_t> matches;
+    for (std::size_t k = low; k < count && path(sorted(k)) == wanted; k++) matches.push_back(sorted(k));
+    return matches;
+}
+
+std::vector<ManifestEntry> loadManifest(const std::string& filename) {
+    if (isBinaryManifest(filename)) {
+        const BinaryManifest manifest(filename);
+        std::vector<ManifestEntry> entries;
+        entries.reserve(manifest.size());
+        for (std::size_t i = 0; i < manifest.size(); i++) entries.push_back(manifest.entry(i));
+        return entries;
+    }
+    std::ifstream in(filename);
+    if (!in) throw std::runtime_error("could not open manifest '" + filename + "'");
+    return readManifest(in);
+}
@@ -0,0 +1,92 @@
+// Binary manifests: the same entries as a text manifest, in a form that is
+// mapped and used in place instead of parsed.
+//
+// Layout, native byte order (the magic tells a foreign file apart):
+//
+//   header    magic "ITFLMAN" + version, entry count, string bytes
+//   records   count x 72 bytes: raw SHA-256, size, mtime, path offset and
+//             length, CRC-32C, flags (which fields are present)
+//   index     count x uint32 record numbers, sorted by path
+//   strings   the paths, back to back
+//
+// Records keep the order they were written in, so converting a text
+// manifest to binary and back gives the same entries, in the same order and
+// spelling. Only comments and blank lines are dropped. Lookups by path and
+// walks in path order go through the index.
+#pragma once
+
+#include "manifest.h"
+#include "mapped.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// True if the file starts with the binary manifest magic
+bool isBinaryManifest(const std::string& filename);
+
+// One record, defined in binmanifest.cpp
+struct ManifestRecord;
+
+// Collects records and paths one entry at a time, without keeping a
+// ManifestEntry per file, then writes them out with the path index
+class BinaryManifestBuilder {
+    public:
+    BinaryManifestBuilder();
+    ~BinaryManifestBuilder();
+
+    void reserve(std::size_t entries);
+    // Throws std::runtime_error if the entry cannot be stored (too many
+    // entries, a path that is too long)
+    void add(const RawManifestEntry& entry);
+    // Throws std::runtime_error if the file cannot be written
+    void write(const std::string& filename) const;
+
+    private:
+    std::vector<ManifestRecord> records;
+    std::string strings;
+};
+
+// Throws std::runtime_error if the file cannot be written or an entry
+// cannot be stored (a digest that is not hex, too many entries).
+void writeBinaryManifest(const std::string& filename, const std::vector<ManifestEntry>& entries);
+
+class BinaryManifest {
+    public:
+    // Throws std::runtime_error if the file cannot be read or is not a
+    // binary manifest
+    explicit BinaryManifest(const std::string& filename);
+
+    std::size_t size() const { return count; }
+    // All paths together, without separators
+    std::uint64_t pathBytes() const { return stringBytes; }
+
+    // Entries in the order they were written. Paths point into the mapping.
+    std::string_view path(std::size_t record) const;
+    ManifestEntry entry(std::size_t record) const;
+    // The same without a copy: fields point into the mapping, except the
+    // CRC-32C, which is put into 'crc32c' big endian
+    RawManifestEntry raw(std::size_t record, unsigned char (&crc32c)[4]) const;
+    // Raw digest, or nullptr if the entry has none
+    const unsigned char* sha256(std::size_t record) const;
+
+    // The record that comes k-th in path order
+    std::size_t sorted(std::size_t k) const;
+    // Records with this path, in the order they were written
+    std::vector<std::size_t> find(std::string_view path) const;
+
+    private:
+    const ManifestRecord& record(std::size_t index) const;
+
+    MappedFile file;
+    const ManifestRecord* records = nullptr;
+    const std::uint32_t* index = nullptr;
+    const char* strings = nullptr;
+    std::size_t count = 0;
+    std::uint64_t stringBytes = 0;
+};
+
+// Read a manifest of either kind
+std::vector<ManifestEntry> loadManifest(const std::string& filename);
@@ -0,0 +1,164 @@
+#include "bufpool.h"
+
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+constexpr std::size_t BuffersPerSlab = BufferPool::SlabSize / io::BufferSize;
+static_assert(BufferPool::SlabSize % io::BufferSize == 0, "buffers must tile a slab");
+
+} // namespace
+
+BufferPool& BufferPool::instance() {
+    static BufferPool pool;
+    return pool;
+}
+
+BufferPool::~BufferPool() {
+#ifndef _WIN32
+    for (char* slab : slabs) munmap(slab, SlabSize);
+#else
+    for (char* slab : slabs) ::operator delete(slab, std::align_val_t(4096));
+#endif
+}
+
+void BufferPool::configure(std::size_t budgetBytes, bool useHugePages) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::size_t slabCount = (budgetBytes + SlabSize - 1) / SlabSize;
+    budget = (slabCount == 0 ? 1 : slabCount) * SlabSize;
+    hugePages = useHugePages;
+}
+
+char* BufferPool::mapSlab(bool& huge) {
+    huge = false;
+#ifndef _WIN32
+#ifdef MAP_HUGETLB
+    if (hugePages) {
+        void* slab = mmap(nullptr, SlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (slab != MAP_FAILED) {
+            huge = true;
+            return static_cast<char*>(slab);
+        }
+    }
+#endif
+    // Over-map and trim so the slab is 2 MiB aligned and THP can back it
+    void* raw = mmap(nullptr, 2 * SlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw);
+    std::uintptr_t aligned = (start + SlabSize - 1) & ~(std::uintptr_t(SlabSize) - 1);
+    if (aligned > start) munmap(raw, aligned - start);
+    std::size_t tail = start + 2 * SlabSize - (aligned + SlabSize);
+    if (tail > 0) munmap(reinterpret_cast<void*>(aligned + SlabSize), tail);
+#ifdef MADV_HUGEPAGE
+    if (hugePages) madvise(reinterpret_cast<void*>(aligned), SlabSize, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<char*>(aligned);
+#else
+    return static_cast<char*>(::operator new(SlabSize, std::align_val_t(4096)));
+#endif
+}
+
+BufferPool::FreeList& BufferPool::freeList(int node) {
+    for (FreeList& list : freeLists) {
+        if (list.node == node) return list;
+    }
+    freeLists.push_back(FreeList{node, {}});
+    return freeLists.back();
+}
+
+BufferPool::Lease BufferPool::acquire(int node) {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        // Local buffer first, then any buffer before growing
+        FreeList& local = freeList(node);
+        FreeList* source = local.buffers.empty() ? nullptr : &local;
+        std::size_t capacity = (slabs.size() + mapping) * BuffersPerSlab;
+        if (source == nullptr && capacity * io::BufferSize >= budget) {
+            for (FreeList& list : freeLists) {
+                if (!list.buffers.empty()) {
+                    source = &list;
+                    break;
+                }
+            }
+        }
+        if (source != nullptr) {
+            char* buffer = source->buffers.back();
+            source->buffers.pop_back();
+            leased++;
+            if (leased > peakLeased) peakLeased = leased;
+            return Lease(this, buffer, source->node);
+        }
+
+        if (capacity * io::BufferSize + SlabSize <= budget) {
+            // Grow by one slab, touched by this thread so it lands on our node
+            mapping++;
+            guard.unlock();
+            bool huge = false;
+            char* slab = mapSlab(huge);
+            if (slab) std::memset(slab, 0, SlabSize);
+            guard.lock();
+            mapping--;
+            if (slab == nullptr) throw std::bad_alloc();
+
+            slabs.push_back(slab);
+            hugeSlabs += huge;
+            FreeList& list = freeList(node);
+            for (std::size_t i = 0; i < BuffersPerSlab; i++) {
+                list.buffers.push_back(slab + i * io::BufferSize);
+            }
+            // Others may have been waiting for this growth to finish
+            returned.notify_all();
+            continue;
+        }
+
+        // At budget: wait for a lease to come back
+        returned.wait(guard);
+    }
+}
+
+void BufferPool::release(char* buffer, int node) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        freeList(node).buffers.push_back(buffer);
+        leased--;
+    }
+    returned.notify_one();
+}
+
+BufferPool::Usage BufferPool::usage() const {
+    std::lock_guard<std::mutex> guard(lock);
+    Usage result;
+    result.slabs = slabs.size();
+    result.hugeSlabs = hugeSlabs;
+    result.budget = budget;
+    result.peakLeased = peakLeased * io::BufferSize;
+    return result;
+}
+
+BufferPool::Lease::Lease(Lease&& other) noexcept :
+    pool(other.pool),
+    buffer(other.buffer),
+    node(other.node)
+{
+    other.buffer = nullptr;
+}
+
+BufferPool::Lease& BufferPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        if (buffer) pool->release(buffer, node);
+        pool = other.pool;
+        buffer = other.buffer;
+        node = other.node;
+        other.buffer = nullptr;
+    }
+    return *this;
+}
+
+BufferPool::Lease::~Lease() {
+    if (buffer) pool->release(buffer, node);
+}
@@ -0,0 +1,94 @@
+// Process-wide pool of read buffers.
+//
+// Buffers are carved out of 2 MiB slabs, backed by explicit huge pages when
+// the kernel has some reserved (MAP_HUGETLB) and advised for transparent
+// huge pages otherwise. Every buffer is page aligned, so it is also good
+// for O_DIRECT. The pool never grows past its memory budget: once every
+// buffer is leased, acquire() waits for one to come back. Slabs remember
+// the NUMA node of the thread that first touched them, and a lease prefers
+// a buffer from the caller's node.
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace io {
+
+// Buffer of size 256KB, what every reader hands to the hasher at once
+constexpr std::size_t BufferSize = 262144;
+
+} // namespace io
+
+class BufferPool {
+    public:
+    // 2 MiB, the x86-64 huge page size
+    static constexpr std::size_t SlabSize = std::size_t(2) << 20;
+    static constexpr std::size_t DefaultBudget = std::size_t(64) << 20;
+
+    static BufferPool& instance();
+
+    // Set the budget (rounded up to whole slabs, at least one) and whether
+    // to try huge pages. Only affects slabs not allocated yet.
+    void configure(std::size_t budgetBytes, bool hugePages);
+
+    class Lease {
+        public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        char* data() const { return buffer; }
+        explicit operator bool() const { return buffer != nullptr; }
+
+        private:
+        friend class BufferPool;
+        Lease(BufferPool* pool, char* buffer, int node) : pool(pool), buffer(buffer), node(node) {}
+
+        BufferPool* pool = nullptr;
+        char* buffer = nullptr;
+        int node = -1;
+    };
+
+    // One io::BufferSize buffer, blocking while the budget is used up. 'node' is the caller's NUMA node, -1 if unknown.
+    Lease acquire(int node = -1);
+
+    struct Usage {
+        std::size_t slabs = 0;
+        std::size_t hugeSlabs = 0;
+        std::size_t budget = 0;
+        std::size_t peakLeased = 0;
+    };
+    Usage usage() const;
+
+    private:
+    BufferPool() = default;
+    ~BufferPool();
+
+    // Map one slab; called without the lock held
+    char* mapSlab(bool& huge);
+    void release(char* buffer, int node);
+
+    struct FreeList {
+        int node;
+        std::vector<char*> buffers;
+    };
+    FreeList& freeList(int node);
+
+    mutable std::mutex lock;
+    std::condition_variable returned;
+    std::vector<FreeList> freeLists;
+    std::vector<char*> slabs;
+    std::size_t budget = DefaultBudget;
+    bool hugePages = true;
+    std::size_t mapping = 0;
+    std::size_t leased = 0;
+    std::size_t peakLeased = 0;
+    std::size_t hugeSlabs = 0;
+};
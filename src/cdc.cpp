@@ -0,0 +1,153 @@
+#include "cdc.h"
+
+#include <algorithm>
+
+namespace {
+
+// Normalization level: the small mask has this many more bits than the
+// average size calls for, the large mask this many fewer
+constexpr int Normalization = 2;
+
+struct GearTable {
+    std::uint64_t value[256];
+    // value << 1, for the first byte of a pair (see Chunker::roll)
+    std::uint64_t shifted[256];
+};
+
+// Pseudo random gear values from splitmix64. The seed is part of the chunk
+// format: change it and every boundary moves.
+constexpr GearTable makeGear() {
+    GearTable table = {};
+    std::uint64_t state = 0x6974666c;
+    for (int i = 0; i < 256; i++) {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        table.value[i] = z ^ (z >> 31);
+        table.shifted[i] = table.value[i] << 1;
+    }
+    return table;
+}
+
+constexpr GearTable Gear = makeGear();
+
+// 'bits' ones just below the top bit. High bits of fp depend on the last
+// few dozen bytes; bit 63 stays clear so the mask can be shifted left once.
+constexpr std::uint64_t maskOf(int bits) {
+    return ((std::uint64_t(1) << bits) - 1) << (63 - bits);
+}
+
+int log2Of(std::uint32_t value) {
+    int bits = 0;
+    while ((std::uint32_t(1) << (bits + 1)) <= value) bits++;
+    return bits;
+}
+
+} // namespace
+
+bool validChunkParams(const ChunkParams& params, std::string& error) {
+    if (params.minSize < 64) {
+        error = "minimum chunk size must be at least 64 bytes";
+    } else if (params.minSize > params.avgSize || params.avgSize > params.maxSize) {
+        error = "chunk sizes must satisfy min <= avg <= max";
+    } else if (params.maxSize > (std::uint32_t(1) << 30)) {
+        error = "maximum chunk size must be at most 1G";
+    } else {
+        return true;
+    }
+    return false;
+}
+
+Chunker::Chunker(const ChunkParams& params, std::vector<Chunk>& chunks)
+    : params(params),
+      maskSmall(maskOf(log2Of(params.avgSize) + Normalization)),
+      maskLarge(maskOf(log2Of(params.avgSize) > Normalization ? log2Of(params.avgSize) - Normalization : 1)),
+      chunks(chunks) {}
+
+// Roll p[i, limit) into fp and stop after the first byte that leaves the
+// masked bits zero. Two bytes per iteration, as in FastCDC 2020: shifting fp
+// by two at once, the first byte's gear value goes in pre-shifted and is
+// tested against the mask shifted by one, which is the same test as rolling
+// byte by byte. The boundaries are identical; the dependency chain per byte
+// is shorter.
+bool Chunker::roll(const unsigned char* p, std::size_t& i, std::size_t limit, std::uint64_t mask) {
+    const std::uint64_t maskShifted = mask << 1;
+    while (i + 2 <= limit) {
+        fp = (fp << 2) + Gear.shifted[p[i]];
+        if ((fp & maskShifted) == 0) {
+            i += 1;
+            return true;
+        }
+        fp += Gear.value[p[i + 1]];
+        i += 2;
+        if ((fp & mask) == 0) return true;
+    }
+    if (i < limit) {
+        fp = (fp << 1) + Gear.value[p[i]];
+        i += 1;
+        if ((fp & mask) == 0) return true;
+    }
+    return false;
+}
+
+bool Chunker::scan(const unsigned char* p, std::size_t size, std::size_t& consumed) {
+    std::size_t i = 0;
+    // Cut-point skipping: nothing before minSize can be a boundary, and the
+    // gear hash starts from zero right after it
+    if (length < params.minSize) {
+        std::size_t skip = params.minSize - length;
+        if (skip >= size) {
+            length += static_cast<std::uint32_t>(size);
+            consumed = size;
+            return false;
+        }
+        i = skip;
+        length = params.minSize;
+    }
+
+    bool found = false;
+    std::size_t start = i;
+    if (length < params.avgSize) {
+        std::size_t limit = i + std::min<std::size_t>(size - i, params.avgSize - length);
+        found = roll(p, i, limit, maskSmall);
+        length += static_cast<std::uint32_t>(i - start);
+        start = i;
+    }
+    if (!found && i < size) {
+        std::size_t limit = i + std::min<std::size_t>(size - i, params.maxSize - length);
+        found = roll(p, i, limit, maskLarge);
+        length += static_cast<std::uint32_t>(i - start);
+        found = found || length == params.maxSize;
+    }
+    consumed = i;
+    return found;
+}
+
+void Chunker::add(const void* data, std::size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    while (size > 0) {
+        std::size_t consumed = 0;
+        bool boundary = scan(p, size, consumed);
+        sha.add(p, consumed);
+        p += consumed;
+        size -= consumed;
+        if (boundary) cut();
+    }
+}
+
+void Chunker::finish() {
+    if (length > 0) cut();
+}
+
+void Chunker::cut() {
+    Chunk chunk;
+    chunk.offset = offset;
+    chunk.length = length;
+    sha.getHash(chunk.digest.data());
+    chunks.push_back(chunk);
+
+    sha.reset();
+    offset += length;
+    length = 0;
+    fp = 0;
+}
@@ -0,0 +1,63 @@
+// Content-defined chunking with FastCDC (Xia et al., USENIX ATC 2016).
+//
+// A gear hash, fp = (fp << 1) + Gear[byte], rolls over the data and a chunk
+// ends where the masked bits of fp are all zero, so boundaries depend on the
+// bytes around them rather than on their offset: inserting a byte near the
+// start of a file only changes the chunks around the insertion. The first
+// minSize bytes of a chunk are skipped without hashing, and normalized
+// chunking uses a stricter mask before avgSize and a looser one after it,
+// which keeps chunk sizes close to the average. No chunk exceeds maxSize.
+//
+// The Chunker is a Sink like any HasherSet (see reader.h), so every backend
+// can feed it. It computes each chunk's SHA-256 in the same pass.
+#pragma once
+
+#include "../lib/sha256.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ChunkParams {
+    std::uint32_t minSize = 2 * 1024;
+    std::uint32_t avgSize = 8 * 1024;
+    std::uint32_t maxSize = 64 * 1024;
+};
+
+// Requires 64 <= min <= avg <= max <= 1 GiB. Sets 'error' if not.
+bool validChunkParams(const ChunkParams& params, std::string& error);
+
+struct Chunk {
+    std::uint64_t offset = 0;
+    std::uint32_t length = 0;
+    std::array<unsigned char, SHA256::HashBytes> digest{};
+};
+
+class Chunker {
+    public:
+    // Appends every completed chunk to 'chunks'
+    Chunker(const ChunkParams& params, std::vector<Chunk>& chunks);
+
+    void add(const void* data, std::size_t size);
+    // End of input: emit the last, possibly short, chunk
+    void finish();
+
+    private:
+    // Find the next boundary in p[0, size). Sets 'consumed' to the bytes up
+    // to and including it, or to 'size' if there is none.
+    bool scan(const unsigned char* p, std::size_t size, std::size_t& consumed);
+    bool roll(const unsigned char* p, std::size_t& i, std::size_t limit, std::uint64_t mask);
+    void cut();
+
+    ChunkParams params;
+    std::uint64_t maskSmall;
+    std::uint64_t maskLarge;
+    std::vector<Chunk>& chunks;
+    SHA256 sha;
+    std::uint64_t fp = 0;
+    std::uint64_t offset = 0;
+    // Bytes in the current chunk
+    std::uint32_t length = 0;
+};
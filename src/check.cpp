@@ -0,0 +1,320 @@
+// itfl check: verify every file listed in a manifest
+#include "../lib/cxxopts.hpp"
+#include "binmanifest.h"
+#include "commands.h"
+#include "dedup.h"
+#include "digest.h"
+#include "hex.h"
+#include "iosched.h"
+#include "manifest.h"
+#include "options.h"
+#include "pathtable.h"
+#include "pool.h"
+#include "prefetch.h"
+#include "progress.h"
+#include "results.h"
+#include "term.h"
+#include "tuner.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+enum class Verdict { Ok, Failed, WrongSize, Unreadable, NoDigest };
+
+struct CheckOptions {
+    // Use the stored CRC-32C as a first pass where the manifest has one
+    bool fast = false;
+    // Also compute SHA-256 when the CRC-32C matches
+    bool escalateAlways = false;
+    // The manifest holds HMAC-SHA256 values made with this key
+    const HMACSHA256::Key* hmacKey = nullptr;
+};
+
+// Verify entry 'i'. 'escalated' is set when the fast tier had to fall back to SHA-256.
+// Digests are compared as bytes, so no hex is made for files that pass.
+Verdict checkEntry(const std::string& path, const ExpectedDigests& expected, std::size_t i, const CheckOptions& opts, const ReadContext& ctx, bool& escalated) {
+    escalated = false;
+    RawFileDigests digests;
+    const unsigned char* sha256 = expected.sha256(i);
+    const unsigned char* crc32c = expected.crc32c(i);
+    auto sha256Matches = [&] { return std::memcmp(digests.sha256, sha256, sizeof(digests.sha256)) == 0; };
+
+    // A recorded size that no longer matches settles it without reading
+    if (expected.hasStat(i)) {
+        std::uint64_t size = 0;
+        std::int64_t mtimeNs = 0;
+        if (!fileStat(path, size, mtimeNs)) return Verdict::Unreadable;
+        if (size != expected.statSize(i)) return Verdict::WrongSize;
+    }
+
+    if (opts.fast && crc32c) {
+        DigestRequest request;
+        request.crc32c = true;
+        request.hmacKey = opts.hmacKey;
+        request.sha256 = opts.escalateAlways && sha256;
+        if (!digestFile(path, request, ctx, digests)) return Verdict::Unreadable;
+
+        if (!request.sha256) {
+            if (std::memcmp(digests.crc32c, crc32c, sizeof(digests.crc32c)) == 0) return Verdict::Ok;
+            if (!sha256) return Verdict::Failed;
+
+            // A CRC mismatch is almost certainly corruption, but let SHA-256 have the final word
+            escalated = true;
+            DigestRequest full;
+            full.hmacKey = opts.hmacKey;
+            if (!digestFile(path, full, ctx, digests)) return Verdict::Unreadable;
+        }
+        return sha256Matches() ? Verdict::Ok : Verdict::Failed;
+    }
+
+    if (!sha256) return Verdict::NoDigest;
+    DigestRequest request;
+    request.hmacKey = opts.hmacKey;
+    if (!digestFile(path, request, ctx, digests)) return Verdict::Unreadable;
+    return sha256Matches() ? Verdict::Ok : Verdict::Failed;
+}
+
+} // namespace
+
+int runCheck(int argc, char* argv[]) {
+    cxxopts::Options options("itfl check", "Verify the files listed in a manifest\n\nUsage:\n itfl check [OPTIONS] <manifest> [paths...]\n\nWith paths, only the entries for those paths are checked.");
+    options.add_options()
+        ("fast", "Triage with the stored CRC-32C, escalating to SHA-256 on mismatch")
+        ("escalate", "When to run SHA-256 in fast mode: mismatch or always", cxxopts::value<std::string>()->default_value("mismatch"))
+        ("hmac-key-file", "Key file: the manifest holds HMAC-SHA256 values made with this key", cxxopts::value<std::string>())
+        ("q,quiet", "Only print files that fail")
+        ("manifest", "Manifest to check", cxxopts::value<std::string>())
+        ("paths", "Only check these paths", cxxopts::value<std::vector<std::string>>())
+        ("help", "Print usage");
+    addCommonOptions(options);
+    options.parse_positional({"manifest", "paths"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("manifest") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "Missing manifest. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+
+    CheckOptions opts;
+    opts.fast = result.count("fast");
+    const std::string escalate = result["escalate"].as<std::string>();
+    if (escalate == "always") {
+        opts.escalateAlways = true;
+    } else if (escalate != "mismatch") {
+        std::cerr << color.red << "Error: " << color.reset << "--escalate must be 'mismatch' or 'always'\n";
+        return 1;
+    }
+    std::unique_ptr<HMACSHA256::Key> hmacKey;
+    if (result.count("hmac-key-file")) {
+        hmacKey = readHmacKey(result["hmac-key-file"].as<std::string>());
+        opts.hmacKey = hmacKey.get();
+    }
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+    IoStats stats;
+    if (common.statsFormat != StatsFormat::None) {
+        common.read.stats = &stats;
+    }
+    bool quiet = result.count("quiet");
+
+    const std::string manifestName = result["manifest"].as<std::string>();
+    std::ifstream manifestStream(manifestName);
+    if (!manifestStream) {
+        std::cerr << color.red << "Error: " << color.reset << "Could not open manifest: '" << manifestName << "'.\n";
+        return 1;
+    }
+    const RunTimer timer;
+    // Paths to open and what they should hash to, by entry
+    ExpectedDigests expected;
+    const PathTable& paths = expected.paths();
+    // Binary records go in as raw bytes, without a round trip through hex
+    auto addRecord = [&](const BinaryManifest& binary, std::size_t record) {
+        unsigned char crc32c[4];
+        expected.add(binary.raw(record, crc32c));
+    };
+    std::size_t notListed = 0;
+    if (result.count("paths") == 0) {
+        if (isBinaryManifest(manifestName)) {
+            const BinaryManifest binary(manifestName);
+            expected.reserve(binary.size(), binary.pathBytes() + binary.size());
+            for (std::size_t record = 0; record < binary.size(); record++) addRecord(binary, record);
+        } else {
+            ManifestReader reader(manifestStream);
+            ManifestEntry entry;
+            while (reader.next(entry)) expected.add(entry);
+        }
+    } else {
+        // A binary manifest is searched in place; a text one is read once,
+        // keeping only the entries asked for
+        const std::vector<std::string>& wanted = result["paths"].as<std::vector<std::string>>();
+        std::unique_ptr<BinaryManifest> binary;
+        std::map<std::string, std::vector<ManifestEntry>> listed;
+        if (isBinaryManifest(manifestName)) {
+            binary = std::make_unique<BinaryManifest>(manifestName);
+        } else {
+            for (const std::string& path : wanted) listed[path];
+            ManifestReader reader(manifestStream);
+            ManifestEntry entry;
+            while (reader.next(entry)) {
+                auto found = listed.find(entry.path);
+                if (found != listed.end()) found->second.push_back(std::move(entry));
+            }
+        }
+        for (const std::string& path : wanted) {
+            std::size_t before = paths.size();
+            if (binary) {
+                for (std::size_t record : binary->find(path)) addRecord(*binary, record);
+            } else {
+                for (const ManifestEntry& entry : listed[path]) expected.add(entry);
+            }
+            if (paths.size() == before) {
+                std::cerr << color.red << "Error: " << color.reset << "Not in manifest: '" << path << "'.\n";
+                notListed++;
+            }
+        }
+    }
+
+    // Entries naming the same file with the same expected digests get one
+    // verdict, worked out through the first of them
+    const SharedPlan shared = planSharing(paths, common.reflinks, expected.keys(), ExpectedDigests::KeyBytes);
+    // Only copied when some entries share
+    PathTable leaderPaths;
+    if (shared.leaders.size() != paths.size()) {
+        leaderPaths.reserve(shared.leaders.size(), 0);
+        for (std::size_t i : shared.leaders) leaderPaths.add(paths[i]);
+    }
+    const PathTable& leaders = shared.leaders.size() != paths.size() ? leaderPaths : paths;
+
+    ProgressCounters counters;
+    std::unique_ptr<ProgressReporter> reporter;
+    if (common.progress) {
+        std::uint64_t totalBytes = 0;
+        for (std::size_t i : shared.leaders) totalBytes += expected.hasStat(i) ? expected.statSize(i) : fileSize(paths.c_str(i));
+        common.read.progress = &counters.bytes;
+        reporter = std::make_unique<ProgressReporter>(counters, totalBytes, paths.size());
+    }
+
+    std::vector<Verdict> verdicts(paths.size());
+    std::vector<char> escalated(paths.size(), 0);
+    std::size_t failed = 0, unreadable = 0, escalations = 0;
+    VerdictWriter writer(std::cout);
+
+    // Verify in parallel, report in manifest order
+    OrderedEmitter emitter(paths.size(), [&](std::size_t i) {
+        Verdict verdict = verdicts[i];
+        escalations += escalated[i];
+        if (quiet && verdict == Verdict::Ok) return;
+
+        switch (verdict) {
+        case Verdict::Ok:
+            writer.write(paths[i], color.green, "OK", color.reset);
+            break;
+        case Verdict::Failed:
+            failed++;
+            writer.write(paths[i], color.red, "FAILED", color.reset);
+            break;
+        case Verdict::WrongSize:
+            failed++;
+            writer.write(paths[i], color.red, "FAILED size differs", color.reset);
+            break;
+        case Verdict::Unreadable:
+            unreadable++;
+            writer.write(paths[i], color.red, "FAILED open or read", color.reset);
+            break;
+        case Verdict::NoDigest:
+            unreadable++;
+            writer.write(paths[i], color.red, "FAILED no SHA-256 in manifest", color.reset);
+            break;
+        }
+        // The progress line shares the terminal, so lines go out one at a time
+        if (reporter) {
+            reporter->clear();
+            writer.flush();
+        }
+    });
+
+    WorkerPool pool(common.jobs, common.topology);
+    std::vector<IoStats> workerStats(pool.size());
+    // The path being checked, one buffer per worker reused for every file
+    std::vector<std::string> workerPaths(pool.size());
+    const BatchPlan plan = planBatch(leaders, common.prefetch);
+    std::unique_ptr<Prefetcher> prefetcher;
+    if (common.prefetch) prefetcher = std::make_unique<Prefetcher>(leaders, plan, pool.size());
+    // With one worker there is never more than one read per disk anyway
+    std::unique_ptr<DeviceScheduler> scheduler;
+    if (pool.size() > 1) scheduler = std::make_unique<DeviceScheduler>(leaders, plan, common.rotationalReaders, common.solidReaders);
+    std::unique_ptr<ConcurrencyTuner> tuner;
+    if (common.tune && scheduler) {
+        common.read.progress = &counters.bytes;
+        tuner = std::make_unique<ConcurrencyTuner>(counters.bytes, pool.size(), [&](std::size_t busy) {
+            scheduler->setLimit(busy);
+            if (prefetcher) prefetcher->setWorkers(busy);
+        }, scheduler->diskLimit(), [&](std::size_t depth) { scheduler->setDiskLimit(depth); });
+    }
+    pool.parallelFor(leaders.size(), [&](std::size_t next, Worker& worker) {
+        std::size_t position = scheduler ? scheduler->take() : next;
+        std::size_t leader = plan.order[position];
+        std::size_t i = shared.leaders[leader];
+        if (prefetcher) prefetcher->started(position);
+        ReadContext ctx = common.read;
+        ctx.node = worker.node;
+        if (ctx.stats) ctx.stats = &workerStats[worker.index];
+        std::string& path = workerPaths[worker.index];
+        path.assign(paths[i]);
+        bool escalatedHere = false;
+        verdicts[i] = checkEntry(path, expected, i, opts, ctx, escalatedHere);
+        escalated[i] = escalatedHere;
+        for (std::size_t follower : shared.followers[leader]) verdicts[follower] = verdicts[i];
+        if (scheduler) scheduler->finished(position);
+        counters.files.fetch_add(1 + shared.followers[leader].size(), std::memory_order_relaxed);
+        emitter.done(i);
+        for (std::size_t follower : shared.followers[leader]) emitter.done(follower);
+    });
+    if (tuner) {
+        tuner->stop();
+        stats.tunedWorkers = tuner->bestWorkers();
+        stats.tunedBytesPerSec = tuner->bestRate();
+        stats.tunedDiskDepth = tuner->bestDepth();
+    }
+    for (const IoStats& workerStat : workerStats) stats.merge(workerStat);
+    stats.linkedFiles = shared.linked;
+    stats.reflinkedFiles = shared.reflinked;
+    stats.residentFiles = plan.resident;
+    if (prefetcher) stats.prefetchedFiles = prefetcher->prefetched();
+    if (scheduler) {
+        stats.disks = scheduler->disks();
+        stats.rotationalDisks = scheduler->rotationalDisks();
+    }
+
+    reporter.reset();
+    writer.flush();
+    printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+    if (tuner) printTuning(std::cerr, *tuner, pool.size());
+    if (opts.fast && escalations > 0) {
+        std::cerr << "itfl: " << escalations << " of " << paths.size() << " files escalated to SHA-256\n";
+    }
+    if (failed > 0) {
+        std::cerr << "itfl: WARNING: " << failed << " computed checksum" << (failed == 1 ? "" : "s") << " did NOT match\n";
+    }
+    if (unreadable > 0) {
+        std::cerr << "itfl: WARNING: " << unreadable << " listed file" << (unreadable == 1 ? "" : "s") << " could not be read\n";
+    }
+    return (failed > 0 || unreadable > 0 || notListed > 0) ? 1 : 0;
+}
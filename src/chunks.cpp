@@ -0,0 +1,134 @@
+// itfl chunks: content-defined chunk boundaries and digests, for syncing
+// only the chunks that changed and for measuring dedup between versions
+#include "../lib/cxxopts.hpp"
+#include "cdc.h"
+#include "commands.h"
+#include "hex.h"
+#include "options.h"
+#include "pool.h"
+#include "progress.h"
+#include "term.h"
+
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+int runChunks(int argc, char* argv[]) {
+    cxxopts::Options options("itfl chunks", "Split files into content-defined chunks (FastCDC) and print each chunk's SHA-256\n\nUsage:\n itfl chunks [OPTIONS] <files...>\n\nPrints '<sha256> <offset> <length>  <path>' per chunk.");
+    options.add_options()
+        ("min", "Smallest chunk (K, M suffixes)", cxxopts::value<std::string>()->default_value("2K"))
+        ("avg", "Average chunk", cxxopts::value<std::string>()->default_value("8K"))
+        ("max", "Largest chunk", cxxopts::value<std::string>()->default_value("64K"))
+        ("files", "Files to chunk", cxxopts::value<std::vector<std::string>>())
+        ("help", "Print usage");
+    addCommonOptions(options);
+    options.parse_positional({"files"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("files") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "No files given. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+
+    ChunkParams params;
+    const struct {
+        const char* name;
+        std::uint32_t* size;
+    } sizes[] = {{"min", &params.minSize}, {"avg", &params.avgSize}, {"max", &params.maxSize}};
+    for (const auto& size : sizes) {
+        std::uint64_t bytes = 0;
+        if (!parseSize(result[size.name].as<std::string>(), bytes) || bytes > (std::uint64_t(1) << 30)) {
+            std::cerr << color.red << "Error: " << color.reset << "Invalid --" << size.name << ": '" << result[size.name].as<std::string>() << "'\n";
+            return 1;
+        }
+        *size.size = static_cast<std::uint32_t>(bytes);
+    }
+    std::string error;
+    if (!validChunkParams(params, error)) {
+        std::cerr << color.red << "Error: " << color.reset << "Invalid chunk sizes: " << error << "\n";
+        return 1;
+    }
+
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+    IoStats stats;
+    if (common.statsFormat != StatsFormat::None) {
+        common.read.stats = &stats;
+    }
+    const RunTimer timer;
+    const std::vector<std::string>& files = result["files"].as<std::vector<std::string>>();
+
+    ProgressCounters counters;
+    std::unique_ptr<ProgressReporter> reporter;
+    if (common.progress) {
+        std::uint64_t totalBytes = 0;
+        for (const std::string& filename : files) totalBytes += fileSize(filename);
+        common.read.progress = &counters.bytes;
+        reporter = std::make_unique<ProgressReporter>(counters, totalBytes, files.size());
+    }
+
+    struct Result {
+        bool ok = false;
+        std::vector<Chunk> chunks;
+    };
+    std::vector<Result> results(files.size());
+    int status = 0;
+
+    // Every chunk seen so far, to tell how much of the input is repeated
+    std::set<std::array<unsigned char, SHA256::HashBytes>> seen;
+    std::uint64_t chunkCount = 0, totalBytes = 0, uniqueBytes = 0;
+
+    OrderedEmitter emitter(files.size(), [&](std::size_t i) {
+        if (reporter) reporter->clear();
+        if (!results[i].ok) {
+            std::cerr << color.red << "Error: " << color.reset << "Could not read file: '" << files[i] << "'.\n";
+            status = 1;
+            return;
+        }
+        for (const Chunk& chunk : results[i].chunks) {
+            std::cout << toHex(chunk.digest.data(), chunk.digest.size()) << ' ' << chunk.offset << ' ' << chunk.length << "  " << files[i] << '\n';
+            chunkCount++;
+            totalBytes += chunk.length;
+            if (seen.insert(chunk.digest).second) uniqueBytes += chunk.length;
+        }
+        // Done with them, do not hold every file's list until the end
+        std::vector<Chunk>().swap(results[i].chunks);
+    });
+
+    WorkerPool pool(common.jobs, common.topology);
+    std::vector<IoStats> workerStats(pool.size());
+    pool.parallelFor(files.size(), [&](std::size_t i, Worker& worker) {
+        ReadContext ctx = common.read;
+        ctx.node = worker.node;
+        if (ctx.stats) ctx.stats = &workerStats[worker.index];
+        Chunker chunker(params, results[i].chunks);
+        results[i].ok = hashFile(files[i], ctx, chunker);
+        if (results[i].ok) chunker.finish();
+        counters.files.fetch_add(1, std::memory_order_relaxed);
+        emitter.done(i);
+    });
+    for (const IoStats& workerStat : workerStats) stats.merge(workerStat);
+
+    reporter.reset();
+    printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+    std::ios::fmtflags flags = std::cerr.flags();
+    std::cerr << std::fixed << std::setprecision(2)
+              << "itfl: " << chunkCount << " chunks, " << totalBytes << " bytes, avg "
+              << (chunkCount == 0 ? 0 : totalBytes / chunkCount) << " bytes; " << seen.size() << " unique, "
+              << uniqueBytes << " bytes (dedup ratio " << (uniqueBytes == 0 ? 1.0 : static_cast<double>(totalBytes) / static_cast<double>(uniqueBytes)) << ")\n";
+    std::cerr.flags(flags);
+    return status;
+}
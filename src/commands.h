@@ -0,0 +1,15 @@
+// Entry points for the itfl subcommands. Each one gets argv with the
+// subcommand name in argv[0] and returns the process exit code.
+#pragma once
+
+int runSum(int argc, char* argv[]);
+int runCheck(int argc, char* argv[]);
+int runBench(int argc, char* argv[]);
+int runDupes(int argc, char* argv[]);
+int runTar(int argc, char* argv[]);
+int runChunks(int argc, char* argv[]);
+int runIndex(int argc, char* argv[]);
+int runIdentify(int argc, char* argv[]);
+int runWatch(int argc, char* argv[]);
+int runConvert(int argc, char* argv[]);
+int runDiff(int argc, char* argv[]);
@@ -0,0 +1,58 @@
+// itfl convert: turn a text manifest into a binary one and back, without
+// losing anything either way
+#include "../lib/cxxopts.hpp"
+#include "binmanifest.h"
+#include "commands.h"
+#include "manifest.h"
+#include "term.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int runConvert(int argc, char* argv[]) {
+    cxxopts::Options options("itfl convert", "Convert a manifest between the text and the binary format\n\nUsage:\n itfl convert [OPTIONS] <manifest>\n\nA text manifest becomes a binary one, which needs -o. A binary manifest becomes text, printed unless -o is given.");
+    options.add_options()
+        ("o,output", "File to write", cxxopts::value<std::string>())
+        ("manifest", "Manifest to convert", cxxopts::value<std::string>())
+        ("help", "Print usage");
+    options.parse_positional({"manifest"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("manifest") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "Missing manifest. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+
+    const std::string manifestName = result["manifest"].as<std::string>();
+    if (!isBinaryManifest(manifestName)) {
+        if (result.count("output") == 0) {
+            std::cerr << color.red << "Error: " << color.reset << "A binary manifest needs an output file (-o).\n";
+            return 1;
+        }
+        writeBinaryManifest(result["output"].as<std::string>(), loadManifest(manifestName));
+        return 0;
+    }
+
+    const BinaryManifest manifest(manifestName);
+    std::ofstream file;
+    if (result.count("output")) {
+        file.open(result["output"].as<std::string>());
+        if (!file) {
+            std::cerr << color.red << "Error: " << color.reset << "Could not write '" << result["output"].as<std::string>() << "'.\n";
+            return 1;
+        }
+    }
+    std::ostream& out = result.count("output") ? file : std::cout;
+    for (std::size_t i = 0; i < manifest.size(); i++) writeManifestEntry(out, manifest.entry(i));
+    out.flush();
+    return out ? 0 : 1;
+}
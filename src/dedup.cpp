@@ -0,0 +1,121 @@
+#include "dedup.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <tuple>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+// Extents fetched per FIEMAP call
+constexpr std::size_t ExtentsPerCall = 128;
+// Files with more extents than this are not worth comparing
+constexpr std::size_t MaxExtents = 4096;
+// Extents whose physical address does not pin down the data
+constexpr std::uint32_t OpaqueExtent = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED |
+                                       FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED |
+                                       FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL;
+
+// Logical offset, physical offset and length of every extent, flattened.
+// FIEMAP_FLAG_SYNC writes back dirty pages first, so data that was changed
+// but not yet moved to its own blocks cannot hide behind shared extents.
+// Returns false if the filesystem cannot tell, or the map is not usable.
+bool extentList(int fd, std::vector<std::uint64_t>& extents) {
+    std::vector<char> request(sizeof(struct fiemap) + ExtentsPerCall * sizeof(struct fiemap_extent));
+    struct fiemap* map = reinterpret_cast<struct fiemap*>(request.data());
+    std::uint64_t start = 0;
+    for (;;) {
+        std::fill(request.begin(), request.end(), 0);
+        map->fm_start = start;
+        map->fm_length = FIEMAP_MAX_OFFSET - start;
+        map->fm_flags = FIEMAP_FLAG_SYNC;
+        map->fm_extent_count = ExtentsPerCall;
+        if (ioctl(fd, FS_IOC_FIEMAP, map) != 0) return false;
+        if (map->fm_mapped_extents == 0) break;
+
+        bool last = false;
+        for (std::uint32_t i = 0; i < map->fm_mapped_extents; i++) {
+            const struct fiemap_extent& extent = map->fm_extents[i];
+            if (extent.fe_flags & OpaqueExtent) return false;
+            extents.push_back(extent.fe_logical);
+            extents.push_back(extent.fe_physical);
+            extents.push_back(extent.fe_length);
+            start = extent.fe_logical + extent.fe_length;
+            last = extent.fe_flags & FIEMAP_EXTENT_LAST;
+        }
+        if (last) break;
+        if (extents.size() / 3 > MaxExtents) return false;
+    }
+    // No extents at all could as well be data the map does not cover
+    return !extents.empty();
+}
+#endif
+
+} // namespace
+
+SharedPlan planSharing(const PathTable& paths, bool reflinks, const unsigned char* keys, std::size_t keyBytes) {
+    SharedPlan plan;
+
+#ifndef _WIN32
+    // Keys are compared as bytes; without keys every path has the empty one
+    typedef std::tuple<dev_t, ino_t, std::string_view> InodeKey;
+    typedef std::tuple<dev_t, off_t, std::string_view, std::vector<std::uint64_t>> ExtentKey;
+    // Position in plan.leaders of the first path seen with each identity
+    std::map<InodeKey, std::size_t> byInode;
+    std::map<ExtentKey, std::size_t> byExtents;
+#else
+    (void)reflinks;
+    (void)keys;
+    (void)keyBytes;
+#endif
+
+    for (std::size_t i = 0; i < paths.size(); i++) {
+#ifndef _WIN32
+        const std::string_view key = keys ? std::string_view(reinterpret_cast<const char*>(keys + i * keyBytes), keyBytes) : std::string_view();
+        struct stat st;
+        if (stat(paths.c_str(i), &st) == 0 && S_ISREG(st.st_mode)) {
+            auto found = byInode.find(InodeKey(st.st_dev, st.st_ino, key));
+            if (found != byInode.end()) {
+                plan.followers[found->second].push_back(i);
+                plan.linked++;
+                continue;
+            }
+
+#ifdef __linux__
+            std::vector<std::uint64_t> extents;
+            int fd = reflinks && st.st_size > 0 ? ::open(paths.c_str(i), O_RDONLY | O_CLOEXEC) : -1;
+            bool mapped = fd >= 0 && extentList(fd, extents);
+            if (fd >= 0) ::close(fd);
+            if (mapped) {
+                ExtentKey extentKey(st.st_dev, st.st_size, key, std::move(extents));
+                auto clone = byExtents.find(extentKey);
+                if (clone != byExtents.end()) {
+                    byInode.emplace(InodeKey(st.st_dev, st.st_ino, key), clone->second);
+                    plan.followers[clone->second].push_back(i);
+                    plan.reflinked++;
+                    continue;
+                }
+                byExtents.emplace(std::move(extentKey), plan.leaders.size());
+            }
+#endif
+            byInode.emplace(InodeKey(st.st_dev, st.st_ino, key), plan.leaders.size());
+        }
+#endif
+        plan.leaders.push_back(i);
+        plan.followers.emplace_back();
+    }
+    return plan;
+}
@@ -0,0 +1,28 @@
+// Hash each distinct file once in commands that take many paths.
+//
+// Paths that are hard links to the same inode always share one result.
+// With --reflinks, regular files on the same filesystem whose FIEMAP extent
+// lists are identical (reflink copies that were never written to) share
+// one too: they are the same blocks on disk, so they hold the same bytes.
+#pragma once
+
+#include "pathtable.h"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+struct SharedPlan {
+    // Batch indices that actually get hashed, in input order
+    std::vector<std::size_t> leaders;
+    // By position in 'leaders': the other batch indices taking its result
+    std::vector<std::vector<std::size_t>> followers;
+    // Followers found by inode, and by extents
+    std::size_t linked = 0;
+    std::size_t reflinked = 0;
+};
+
+// Group the batch. When 'keys' is given, 'keyBytes' raw bytes per path back
+// to back, only paths with equal keys may share a result; check uses this
+// so entries with different expected digests keep their own verdicts.
+SharedPlan planSharing(const PathTable& paths, bool reflinks, const unsigned char* keys = nullptr, std::size_t keyBytes = 0);
@@ -0,0 +1,34 @@
+#include "device.h"
+
+#ifndef _WIN32
+#include "topology.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sys/sysmacros.h>
+
+DeviceInfo describeDevice(dev_t device) {
+    DeviceInfo info;
+    if (major(device) == 0) return info;
+
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::path link = fs::path(sysfsRoot()) / "dev/block" / (std::to_string(major(device)) + ":" + std::to_string(minor(device)));
+    fs::path dir = fs::canonical(link, error);
+    if (error) return info;
+
+    // Partitions have no queue directory of their own, their disk does
+    if (!fs::exists(dir / "queue", error) && fs::exists(dir / "partition", error)) {
+        dir = dir.parent_path();
+    }
+
+    std::ifstream rotational(dir / "queue/rotational");
+    int value = 0;
+    if (!(rotational >> value)) return info;
+
+    info.known = true;
+    info.rotational = value != 0;
+    info.disk = dir.filename().string();
+    return info;
+}
+#endif
@@ -0,0 +1,18 @@
+// What the block device under a file looks like, from sysfs
+#pragma once
+
+#include <string>
+
+#ifndef _WIN32
+#include <sys/types.h>
+
+struct DeviceInfo {
+    // False when st_dev is not a real block device (tmpfs, overlay, NFS...)
+    bool known = false;
+    bool rotational = false;
+    // Kernel name of the whole disk, e.g. "sda" for a file on sda1
+    std::string disk;
+};
+
+DeviceInfo describeDevice(dev_t device);
+#endif
@@ -0,0 +1,334 @@
+// itfl diff: what changed between two snapshots of a tree.
+//
+// Both sides are walked in path order and merge-joined, a batch of rows at
+// a time, so memory stays bounded however many files there are. The new
+// side is a manifest, or a directory tree on disk: then only files whose
+// size or mtime differs from the old manifest are read again.
+#include "../lib/cxxopts.hpp"
+#include "binmanifest.h"
+#include "commands.h"
+#include "digest.h"
+#include "manifest.h"
+#include "options.h"
+#include "pool.h"
+#include "progress.h"
+#include "term.h"
+#include "walk.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Rows joined, hashed and printed together
+constexpr std::size_t BatchRows = 4096;
+
+// Entries of one side in path order, one at a time
+class Cursor {
+    public:
+    virtual ~Cursor() = default;
+    virtual bool next(ManifestEntry& entry) = 0;
+};
+
+// Through the path index, straight from the mapping
+class BinaryCursor : public Cursor {
+    public:
+    explicit BinaryCursor(const std::string& filename) : manifest(filename) {}
+    bool next(ManifestEntry& entry) override {
+        if (position == manifest.size()) return false;
+        entry = manifest.entry(manifest.sorted(position++));
+        return true;
+    }
+
+    private:
+    BinaryManifest manifest;
+    std::size_t position = 0;
+};
+
+// A text manifest that is already sorted, streamed line by line
+class TextCursor : public Cursor {
+    public:
+    explicit TextCursor(const std::string& filename) : file(filename), reader(file), name(filename) {}
+    bool next(ManifestEntry& entry) override {
+        if (!reader.next(entry)) return false;
+        if (entry.path < previous) throw std::runtime_error("'" + name + "' changed while it was read");
+        previous = entry.path;
+        return true;
+    }
+
+    private:
+    std::ifstream file;
+    ManifestReader reader;
+    std::string name;
+    std::string previous;
+};
+
+// A text manifest in any other order, read whole and sorted
+class SortedCursor : public Cursor {
+    public:
+    explicit SortedCursor(std::vector<ManifestEntry> sorted) : entries(std::move(sorted)) {
+        std::stable_sort(entries.begin(), entries.end(), [](const ManifestEntry& a, const ManifestEntry& b) { return a.path < b.path; });
+    }
+    bool next(ManifestEntry& entry) override {
+        if (position == entries.size()) return false;
+        entry = std::move(entries[position++]);
+        return true;
+    }
+
+    private:
+    std::vector<ManifestEntry> entries;
+    std::size_t position = 0;
+};
+
+// Files on disk with their size and mtime, digests still to be computed.
+// The tree is listed one directory at a time as the join gets there.
+class TreeCursor : public Cursor {
+    public:
+    TreeCursor(const std::string& root, std::vector<std::string>& errors) : walker(root, errors) {}
+    bool next(ManifestEntry& entry) override {
+        std::string path;
+        while (walker.next(path)) {
+            entry = ManifestEntry();
+            entry.path = std::move(path);
+            // Gone since it was listed: it simply is not in the new snapshot
+            if (fileStat(entry.path, entry.size, entry.mtimeNs)) {
+                entry.hasStat = true;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    private:
+    TreeWalker walker;
+};
+
+// Whether the paths of a text manifest are in byte order, found without
+// parsing the digests
+bool textSorted(const std::string& filename) {
+    std::ifstream in(filename);
+    std::string line, previous;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        std::size_t separator = std::min(line.find("  "), line.find(" *"));
+        if (separator == std::string::npos) continue;
+        std::string path = line.substr(separator + 2);
+        // Malformed lines are left for the ManifestReader to report
+        if (line[0] == '\\' && !unescapeManifestPath(path)) continue;
+        if (path < previous) return false;
+        previous = std::move(path);
+    }
+    return true;
+}
+
+std::unique_ptr<Cursor> openManifest(const std::string& filename) {
+    if (isBinaryManifest(filename)) return std::make_unique<BinaryCursor>(filename);
+    std::ifstream probe(filename);
+    if (!probe) throw std::runtime_error("could not open manifest '" + filename + "'");
+    if (textSorted(filename)) return std::make_unique<TextCursor>(filename);
+    std::cerr << "itfl: '" << filename << "' is not sorted by path, reading it whole\n";
+    return std::make_unique<SortedCursor>(loadManifest(filename));
+}
+
+// Same content as far as the digests both sides have can tell
+bool sameContent(const ManifestEntry& a, const ManifestEntry& b) {
+    if (!a.sha256.empty() && !b.sha256.empty()) return a.sha256 == b.sha256;
+    if (!a.crc32c.empty() && !b.crc32c.empty()) return a.crc32c == b.crc32c;
+    return false;
+}
+
+// What identifies the content in the output
+std::string digestOf(const ManifestEntry& entry) {
+    return entry.sha256.empty() ? "crc32c:" + entry.crc32c : entry.sha256;
+}
+
+// One output line, its path escaped like a manifest's
+void printChange(const char* change, const ManifestEntry& entry) {
+    if (manifestPathNeedsEscape(entry.path)) {
+        std::cout << '\\' << change << ' ' << digestOf(entry) << "  " << escapeManifestPath(entry.path) << '\n';
+    } else {
+        std::cout << change << ' ' << digestOf(entry) << "  " << entry.path << '\n';
+    }
+}
+
+struct Row {
+    bool hasOld = false;
+    bool hasNew = false;
+    ManifestEntry old;
+    ManifestEntry current;
+    // Tree side: the file has to be read to know its digest
+    bool rehash = false;
+    bool ok = true;
+};
+
+} // namespace
+
+int runDiff(int argc, char* argv[]) {
+    cxxopts::Options options("itfl diff", "Show what changed between two snapshots\n\nUsage:\n itfl diff [OPTIONS] <old manifest> <new manifest or directory>\n\nPrints 'added', 'removed' or 'modified', a SHA-256 and the path of every difference, in path order. Against a directory, only files whose size or mtime differs from the old manifest are hashed. Exits with 1 if anything changed.");
+    options.add_options()
+        ("old", "Manifest of the old snapshot", cxxopts::value<std::string>())
+        ("new", "Manifest of the new snapshot, or the directory it was taken of", cxxopts::value<std::string>())
+        ("hmac-key-file", "Key file: the manifests hold HMAC-SHA256 values made with this key", cxxopts::value<std::string>())
+        ("help", "Print usage");
+    addCommonOptions(options);
+    options.parse_positional({"old", "new"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("old") == 0 || result.count("new") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "Two snapshots are needed. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+    IoStats stats;
+    if (common.statsFormat != StatsFormat::None) {
+        common.read.stats = &stats;
+    }
+    const RunTimer timer;
+    int status = 0;
+
+    std::unique_ptr<HMACSHA256::Key> hmacKey;
+    if (result.count("hmac-key-file")) hmacKey = readHmacKey(result["hmac-key-file"].as<std::string>());
+
+    const std::string newName = result["new"].as<std::string>();
+    std::error_code error;
+    const bool tree = std::filesystem::is_directory(newName, error);
+    std::unique_ptr<Cursor> oldSide = openManifest(result["old"].as<std::string>());
+    std::unique_ptr<Cursor> newSide;
+    // Directories the tree walk could not read, reported with each batch
+    std::vector<std::string> walkErrors;
+    auto reportWalkErrors = [&] {
+        for (const std::string& walkError : walkErrors) {
+            std::cerr << color.red << "Error: " << color.reset << walkError << "\n";
+            status = 1;
+        }
+        walkErrors.clear();
+    };
+    if (tree) {
+        newSide = std::make_unique<TreeCursor>(newName, walkErrors);
+    } else {
+        newSide = openManifest(newName);
+    }
+
+    ProgressCounters counters;
+    std::unique_ptr<ProgressReporter> reporter;
+    if (common.progress) {
+        common.read.progress = &counters.bytes;
+        reporter = std::make_unique<ProgressReporter>(counters, 0, 0);
+    }
+    WorkerPool pool(common.jobs, common.topology);
+    std::vector<IoStats> workerStats(pool.size());
+
+    // A path listed twice counts once, through its first entry
+    std::size_t repeated = 0;
+    auto advance = [&](Cursor& cursor, ManifestEntry& entry, bool& valid) {
+        std::string previous = std::move(entry.path);
+        while ((valid = cursor.next(entry)) && entry.path == previous) repeated++;
+    };
+    ManifestEntry oldEntry, newEntry;
+    bool haveOld = oldSide->next(oldEntry), haveNew = newSide->next(newEntry);
+
+    std::size_t added = 0, removed = 0, modified = 0, unchanged = 0, unreadable = 0;
+    std::uint64_t rehashedFiles = 0, rehashedBytes = 0;
+    std::vector<Row> rows;
+    std::vector<std::size_t> toHash;
+    while (haveOld || haveNew) {
+        rows.clear();
+        while (rows.size() < BatchRows && (haveOld || haveNew)) {
+            Row row;
+            int order = !haveOld ? 1 : !haveNew ? -1 : oldEntry.path.compare(newEntry.path);
+            if (order <= 0) {
+                row.hasOld = true;
+                row.old = oldEntry;
+                advance(*oldSide, oldEntry, haveOld);
+            }
+            if (order >= 0) {
+                row.hasNew = true;
+                row.current = newEntry;
+                advance(*newSide, newEntry, haveNew);
+            }
+            // Unchanged metadata is taken to mean unchanged content
+            if (tree && row.hasNew) {
+                const ManifestEntry& old = row.old;
+                row.rehash = !row.hasOld || !old.hasStat || old.size != row.current.size || old.mtimeNs != row.current.mtimeNs;
+                if (!row.rehash) {
+                    row.current.sha256 = old.sha256;
+                    row.current.crc32c = old.crc32c;
+                }
+            }
+            rows.push_back(std::move(row));
+        }
+
+        toHash.clear();
+        for (std::size_t i = 0; i < rows.size(); i++) {
+            if (rows[i].rehash) toHash.push_back(i);
+        }
+        pool.parallelFor(toHash.size(), [&](std::size_t k, Worker& worker) {
+            Row& row = rows[toHash[k]];
+            ReadContext ctx = common.read;
+            ctx.node = worker.node;
+            if (ctx.stats) ctx.stats = &workerStats[worker.index];
+            // A CRC-32C is enough to compare against an old entry that only has one
+            DigestRequest request;
+            request.hmacKey = hmacKey.get();
+            request.sha256 = !row.hasOld || !row.old.sha256.empty();
+            request.crc32c = row.hasOld && row.old.sha256.empty() && !row.old.crc32c.empty();
+            FileDigests digests;
+            row.ok = digestFile(row.current.path, request, ctx, digests);
+            row.current.sha256 = digests.sha256;
+            row.current.crc32c = digests.crc32c;
+            counters.files.fetch_add(1, std::memory_order_relaxed);
+        });
+
+        if (reporter) reporter->clear();
+        reportWalkErrors();
+        for (Row& row : rows) {
+            if (row.rehash) {
+                rehashedFiles++;
+                rehashedBytes += row.current.size;
+            }
+            if (!row.ok) {
+                std::cerr << color.red << "Error: " << color.reset << "Could not read file: '" << row.current.path << "'.\n";
+                unreadable++;
+            } else if (!row.hasNew) {
+                removed++;
+                printChange("removed", row.old);
+            } else if (!row.hasOld) {
+                added++;
+                printChange("added", row.current);
+            } else if (!sameContent(row.old, row.current)) {
+                modified++;
+                printChange("modified", row.current);
+            } else {
+                unchanged++;
+            }
+        }
+    }
+    reportWalkErrors();
+    for (const IoStats& workerStat : workerStats) stats.merge(workerStat);
+
+    reporter.reset();
+    printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+    std::cerr << "itfl: " << added << " added, " << removed << " removed, " << modified << " modified, " << unchanged << " unchanged";
+    if (tree) std::cerr << "; rehashed " << rehashedFiles << " files, " << rehashedBytes << " bytes";
+    std::cerr << '\n';
+    if (repeated > 0) std::cerr << "itfl: " << repeated << " repeated path(s) ignored\n";
+    if (added + removed + modified + unreadable > 0) status = 1;
+    return status;
+}
@@ -0,0 +1,58 @@
+#include "digest.h"
+
+#include "../lib/crc32c.h"
+#include "../lib/sha256.h"
+#include "hasher.h"
+#include "hex.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+// S is SHA256, or HMACSHA256 already keyed
+template <typename S>
+bool digestWith(HasherSet<S, CRC32C>& hashers, const std::string& filename, const DigestRequest& request, const ReadContext& ctx, RawFileDigests& digests) {
+    hashers.template enable<0>(request.sha256);
+    hashers.template enable<1>(request.crc32c);
+
+    if (!hashFile(filename, ctx, hashers)) {
+        return false;
+    }
+
+    std::uint64_t start = ctx.stats ? nowNs() : 0;
+    if (request.sha256) hashers.template get<0>().getHash(digests.sha256);
+    if (request.crc32c) hashers.template get<1>().getHash(digests.crc32c);
+    if (ctx.stats) ctx.stats->finalizeNs += nowNs() - start;
+    return true;
+}
+
+} // namespace
+
+bool digestFile(const std::string& filename, const DigestRequest& request, const ReadContext& ctx, RawFileDigests& digests) {
+    if (request.hmacKey && request.sha256) {
+        HasherSet<HMACSHA256, CRC32C> hashers;
+        hashers.get<0>() = HMACSHA256(*request.hmacKey);
+        return digestWith(hashers, filename, request, ctx, digests);
+    }
+    HasherSet<SHA256, CRC32C> hashers;
+    return digestWith(hashers, filename, request, ctx, digests);
+}
+
+bool digestFile(const std::string& filename, const DigestRequest& request, const ReadContext& ctx, FileDigests& digests) {
+    RawFileDigests raw;
+    if (!digestFile(filename, request, ctx, raw)) return false;
+    digests.sha256 = request.sha256 ? toHex(raw.sha256, sizeof(raw.sha256)) : std::string();
+    digests.crc32c = request.crc32c ? toHex(raw.crc32c, sizeof(raw.crc32c)) : std::string();
+    return true;
+}
+
+std::unique_ptr<HMACSHA256::Key> readHmacKey(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) throw std::runtime_error("could not open key file '" + filename + "'");
+    const std::string key((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (in.bad()) throw std::runtime_error("could not read key file '" + filename + "'");
+    if (key.empty()) throw std::runtime_error("key file '" + filename + "' is empty");
+    return std::make_unique<HMACSHA256::Key>(key.data(), key.size());
+}
@@ -0,0 +1,41 @@
+// Hashing of whole files
+#pragma once
+
+#include "../lib/hmacsha256.h"
+#include "../lib/sha256.h"
+#include "reader.h"
+
+#include <memory>
+#include <string>
+
+// Which digests to compute while reading a file. All of them are fed from
+// the same buffers, so asking for more than one costs no extra I/O.
+struct DigestRequest {
+    bool sha256 = true;
+    bool crc32c = false;
+    // When set, the SHA-256 is an HMAC-SHA256 with this key
+    const HMACSHA256::Key* hmacKey = nullptr;
+};
+
+// Hex strings, empty when not requested
+struct FileDigests {
+    std::string sha256;
+    std::string crc32c;
+};
+
+// The same as bytes, for batches that keep millions of them. Fields that
+// were not requested are left alone.
+struct RawFileDigests {
+    unsigned char sha256[SHA256::HashBytes];
+    // Big endian, the order the hex form is printed in
+    unsigned char crc32c[4];
+};
+
+// Open a file and compute the requested digests in a single pass.
+// Returns false if the file could not be opened or read.
+bool digestFile(const std::string& filename, const DigestRequest& request, const ReadContext& ctx, RawFileDigests& digests);
+bool digestFile(const std::string& filename, const DigestRequest& request, const ReadContext& ctx, FileDigests& digests);
+
+// The key for --hmac-key-file: the whole file, byte for byte. Throws
+// std::runtime_error if it cannot be read or is empty.
+std::unique_ptr<HMACSHA256::Key> readHmacKey(const std::string& filename);
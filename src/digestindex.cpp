@@ -0,0 +1,213 @@
+#include "digestindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+
+const char Magic[8] = {'I', 'T', 'F', 'L', 'I', 'D', 'X', 1};
+
+struct Header {
+    char magic[8];
+    std::uint32_t digestBytes;
+    std::uint32_t bloomHashes;
+    std::uint64_t count;
+    std::uint64_t bloomBytes;
+    std::uint64_t sourceCount;
+    std::uint64_t stringBytes;
+};
+
+constexpr std::size_t FanoutBytes = 256 * sizeof(std::uint64_t);
+
+// The digests are already uniform, so two words of one make the two hashes
+// for double hashing: probe i tests bit (h1 + i * h2) mod bits.
+void bloomProbes(const unsigned char* digest, std::uint64_t& h1, std::uint64_t& h2) {
+    std::memcpy(&h1, digest, sizeof(h1));
+    std::memcpy(&h2, digest + sizeof(h1), sizeof(h2));
+    h2 |= 1;
+}
+
+} // namespace
+
+struct IndexRecord {
+    unsigned char digest[SHA256::HashBytes];
+    std::uint32_t source;
+    // Offset into the strings
+    std::uint32_t path;
+};
+
+static_assert(sizeof(Header) == 48, "index header layout");
+
+std::size_t buildDigestIndex(const std::string& filename, const std::vector<IndexSource>& sources, unsigned bloomBitsPerEntry) {
+    struct Entry {
+        const RawDigest* digest;
+        std::uint32_t source;
+        const std::string* path;
+    };
+    std::vector<Entry> entries;
+    for (std::size_t s = 0; s < sources.size(); s++) {
+        for (const auto& entry : sources[s].entries) {
+            entries.push_back({&entry.first, static_cast<std::uint32_t>(s), &entry.second});
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return std::tie(*a.digest, a.source, *a.path) < std::tie(*b.digest, b.source, *b.path);
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return *a.digest == *b.digest && a.source == b.source && *a.path == *b.path;
+    }), entries.end());
+
+    // Strings: source names first, then each distinct path once
+    std::string strings;
+    std::vector<std::uint32_t> sourceOffsets;
+    auto addString = [&](const std::string& text) {
+        if (strings.size() + text.size() + 1 > UINT32_MAX) throw std::runtime_error("too many paths for one index");
+        std::uint32_t offset = static_cast<std::uint32_t>(strings.size());
+        strings.append(text);
+        strings.push_back('\0');
+        return offset;
+    };
+    for (const IndexSource& source : sources) sourceOffsets.push_back(addString(source.name));
+
+    std::vector<IndexRecord> records(entries.size());
+    std::uint64_t fanout[256] = {};
+    {
+        std::vector<std::pair<const std::string*, std::uint32_t>> paths;
+        for (std::size_t i = 0; i < entries.size(); i++) paths.emplace_back(entries[i].path, static_cast<std::uint32_t>(i));
+        std::sort(paths.begin(), paths.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
+        std::uint32_t offset = 0;
+        for (std::size_t i = 0; i < paths.size(); i++) {
+            if (i == 0 || *paths[i].first != *paths[i - 1].first) offset = addString(*paths[i].first);
+            records[paths[i].second].path = offset;
+        }
+    }
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        std::memcpy(records[i].digest, entries[i].digest->data(), SHA256::HashBytes);
+        records[i].source = entries[i].source;
+        fanout[records[i].digest[0]]++;
+    }
+    for (int b = 1; b < 256; b++) fanout[b] += fanout[b - 1];
+
+    // k = bits per entry * ln 2 minimizes false positives, about 1% at 10 bits
+    std::vector<unsigned char> bloom;
+    std::uint32_t hashes = 0;
+    if (bloomBitsPerEntry > 0 && !records.empty()) {
+        std::uint64_t bits = (records.size() * bloomBitsPerEntry + 63) / 64 * 64;
+        bloom.assign(bits / 8, 0);
+        hashes = static_cast<std::uint32_t>(std::clamp(std::lround(bloomBitsPerEntry * std::log(2.0)), 1L, 16L));
+        for (const IndexRecord& record : records) {
+            std::uint64_t h1, h2;
+            bloomProbes(record.digest, h1, h2);
+            for (std::uint32_t i = 0; i < hashes; i++) {
+                std::uint64_t bit = (h1 + i * h2) % bits;
+                bloom[bit / 8] |= static_cast<unsigned char>(1u << (bit % 8));
+            }
+        }
+    }
+
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.digestBytes = SHA256::HashBytes;
+    header.bloomHashes = hashes;
+    header.count = records.size();
+    header.bloomBytes = bloom.size();
+    header.sourceCount = sourceOffsets.size();
+    header.stringBytes = strings.size();
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(fanout), FanoutBytes);
+    out.write(reinterpret_cast<const char*>(bloom.data()), static_cast<std::streamsize>(bloom.size()));
+    out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(IndexRecord)));
+    out.write(reinterpret_cast<const char*>(sourceOffsets.data()), static_cast<std::streamsize>(sourceOffsets.size() * sizeof(std::uint32_t)));
+    out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    out.close();
+    if (!out) throw std::runtime_error("could not write index '" + filename + "'");
+    return records.size();
+}
+
+DigestIndex::DigestIndex(const std::string& filename) : file(filename, "index") {
+    const unsigned char* data = file.data();
+    const std::size_t length = file.size();
+    Header header = {};
+    bool valid = length >= sizeof(Header);
+    if (valid) {
+        std::memcpy(&header, data, sizeof(header));
+        valid = std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 && header.digestBytes == SHA256::HashBytes;
+    }
+    // Section by section, so huge counts cannot overflow the sum
+    std::uint64_t offset = sizeof(Header) + FanoutBytes;
+    auto section = [&](std::uint64_t count, std::uint64_t size) {
+        if (!valid || count > (length - std::min<std::uint64_t>(offset, length)) / size) {
+            valid = false;
+            return offset;
+        }
+        std::uint64_t start = offset;
+        offset += count * size;
+        return start;
+    };
+    valid = valid && offset <= length;
+    std::uint64_t bloomAt = section(header.bloomBytes, 1);
+    std::uint64_t recordsAt = section(header.count, sizeof(IndexRecord));
+    std::uint64_t sourcesAt = section(header.sourceCount, sizeof(std::uint32_t));
+    std::uint64_t stringsAt = section(header.stringBytes, 1);
+    valid = valid && offset == length && header.bloomBytes % 8 == 0 && (header.stringBytes == 0 || data[length - 1] == '\0');
+    fanout = reinterpret_cast<const std::uint64_t*>(data + sizeof(Header));
+    for (int b = 0; valid && b < 256; b++) {
+        valid = fanout[b] <= header.count && (b == 0 || fanout[b] >= fanout[b - 1]);
+    }
+    valid = valid && fanout[255] == header.count;
+    if (!valid) {
+        throw std::runtime_error("'" + filename + "' is not an itfl index");
+    }
+
+    bloom = data + bloomAt;
+    records = reinterpret_cast<const IndexRecord*>(data + recordsAt);
+    sources = reinterpret_cast<const std::uint32_t*>(data + sourcesAt);
+    strings = reinterpret_cast<const char*>(data + stringsAt);
+    count = header.count;
+    sourceCount = header.sourceCount;
+    stringBytes = header.stringBytes;
+    bloomBits = header.bloomBytes * 8;
+    bloomHashes = header.bloomHashes;
+}
+
+bool DigestIndex::mayContain(const unsigned char* digest) const {
+    if (bloomBits == 0) return true;
+    std::uint64_t h1, h2;
+    bloomProbes(digest, h1, h2);
+    for (std::uint32_t i = 0; i < bloomHashes; i++) {
+        std::uint64_t bit = (h1 + i * h2) % bloomBits;
+        if (!(bloom[bit / 8] & (1u << (bit % 8)))) return false;
+    }
+    return true;
+}
+
+std::vector<IndexMatch> DigestIndex::find(const unsigned char* digest, bool* ruledOut) const {
+    std::vector<IndexMatch> matches;
+    bool filtered = !mayContain(digest);
+    if (ruledOut) *ruledOut = filtered;
+    if (filtered) return matches;
+
+    const IndexRecord* first = records + (digest[0] == 0 ? 0 : fanout[digest[0] - 1]);
+    const IndexRecord* last = records + fanout[digest[0]];
+    struct ByDigest {
+        bool operator()(const IndexRecord& record, const unsigned char* digest) const {
+            return std::memcmp(record.digest, digest, SHA256::HashBytes) < 0;
+        }
+        bool operator()(const unsigned char* digest, const IndexRecord& record) const {
+            return std::memcmp(digest, record.digest, SHA256::HashBytes) < 0;
+        }
+    };
+    auto range = std::equal_range(first, last, digest, ByDigest());
+    for (const IndexRecord* record = range.first; record != range.second; ++record) {
+        // Offsets are not checked when the index is opened, only when used
+        if (record->source >= sourceCount || record->path >= stringBytes || sources[record->source] >= stringBytes) continue;
+        matches.push_back({strings + sources[record->source], strings + record->path});
+    }
+    return matches;
+}
@@ -0,0 +1,75 @@
+// Known-digest index: a sorted table of SHA-256 digests, each naming the
+// manifest it came from and the path it had there, built once and mapped
+// read-only by every query.
+//
+// Layout, native byte order (the magic tells a foreign index apart):
+//
+//   header    magic "ITFLIDX" + version, counts and section sizes
+//   fanout    256 x uint64, records whose first digest byte is <= b
+//   bloom     optional Bloom filter over the digests, bloomBytes long
+//   records   count x {digest[32], uint32 source, uint32 path}, sorted
+//   sources   sourceCount x uint32, offsets of the manifest names
+//   strings   NUL-terminated names and paths
+//
+// Opening checks the header against the file size and nothing else, so
+// startup costs the same for ten entries as for ten million. A lookup is a
+// Bloom probe, then a binary search inside one fanout bucket.
+#pragma once
+
+#include "mapped.h"
+#include "rawdigest.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct IndexSource {
+    // Manifest name, as given to 'itfl index build'
+    std::string name;
+    std::vector<std::pair<RawDigest, std::string>> entries;
+};
+
+// Write an index of every digest in 'sources'. bloomBitsPerEntry = 0 leaves
+// the Bloom filter out. Throws std::runtime_error if it cannot be written.
+// Returns the number of distinct records.
+std::size_t buildDigestIndex(const std::string& filename, const std::vector<IndexSource>& sources, unsigned bloomBitsPerEntry);
+
+struct IndexMatch {
+    const char* source;
+    const char* path;
+};
+
+// One digest in the file, defined in digestindex.cpp
+struct IndexRecord;
+
+class DigestIndex {
+    public:
+    // Maps the index. Throws std::runtime_error if it cannot be read or is
+    // not a valid index.
+    explicit DigestIndex(const std::string& filename);
+
+    // Every entry with this digest, in source order. 'ruledOut' is set when
+    // the Bloom filter alone answered.
+    std::vector<IndexMatch> find(const unsigned char* digest, bool* ruledOut = nullptr) const;
+
+    // False if the digest is certainly not in the index. Answered by the
+    // Bloom filter alone, always true without one.
+    bool mayContain(const unsigned char* digest) const;
+
+    std::uint64_t size() const { return count; }
+    bool hasBloom() const { return bloomBits > 0; }
+
+    private:
+    MappedFile file;
+    const std::uint64_t* fanout = nullptr;
+    const unsigned char* bloom = nullptr;
+    const IndexRecord* records = nullptr;
+    const std::uint32_t* sources = nullptr;
+    const char* strings = nullptr;
+    std::uint64_t count = 0;
+    std::uint64_t sourceCount = 0;
+    std::uint64_t stringBytes = 0;
+    std::uint64_t bloomBits = 0;
+    std::uint32_t bloomHashes = 0;
+};
@@ -0,0 +1,280 @@
+// itfl dupes: find files with identical content under directory trees.
+//
+// Three passes, each only looking at what the previous one could not tell
+// apart. Files with a unique size are ruled out without any I/O, a SHA-256
+// of the first and last few KiB rules out most of the rest, and only files
+// that still collide are hashed in full.
+#include "../lib/cxxopts.hpp"
+#include "../lib/sha256.h"
+#include "commands.h"
+#include "dedup.h"
+#include "digest.h"
+#include "options.h"
+#include "pool.h"
+#include "progress.h"
+#include "rawdigest.h"
+#include "term.h"
+#include "walk.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Bytes hashed from each end of a file in the partial pass
+constexpr std::uint64_t PartialBytes = 4096;
+
+// SHA-256 of the first and last PartialBytes, both ranges pread() into a
+// pooled buffer. Files up to twice that are hashed whole, so for them this
+// is the full digest.
+bool partialDigest(const std::string& path, std::uint64_t size, const ReadContext& ctx, RawDigest& digest) {
+#ifndef _WIN32
+    IoStats* stats = ctx.stats;
+    std::uint64_t start = stats ? nowNs() : 0;
+    if (stats) stats->files++;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (stats) stats->openNs += nowNs() - start;
+    if (fd < 0) return false;
+    if (stats) stats->backendFiles[static_cast<std::size_t>(Backend::Pread)]++;
+
+    SHA256 sha;
+    bool ok;
+    if (size <= 2 * PartialBytes) {
+        ok = io::readRange(fd, 0, size, sha, ctx);
+    } else {
+        ok = io::readRange(fd, 0, PartialBytes, sha, ctx) && io::readRange(fd, size - PartialBytes, PartialBytes, sha, ctx);
+    }
+    ::close(fd);
+    if (!ok) return false;
+    sha.getHash(digest.data());
+    return true;
+#else
+    (void)path;
+    (void)size;
+    (void)ctx;
+    (void)digest;
+    return false;
+#endif
+}
+
+// What one pass did
+struct Pass {
+    std::uint64_t files = 0;
+    std::uint64_t bytesRead = 0;
+    // Files the pass told apart from all others, and their bytes that were never read
+    std::uint64_t ruledOut = 0;
+    std::uint64_t bytesSaved = 0;
+};
+
+// Split every group by the digests computed for its members. Members that
+// could not be read are dropped, members left on their own go to 'loners'.
+std::vector<std::vector<std::size_t>> regroup(const std::vector<std::vector<std::size_t>>& groups, const std::vector<RawDigest>& digests, const std::vector<char>& ok, std::vector<std::size_t>& loners) {
+    std::vector<std::vector<std::size_t>> result;
+    for (const std::vector<std::size_t>& group : groups) {
+        std::map<RawDigest, std::vector<std::size_t>> split;
+        for (std::size_t member : group) {
+            if (ok[member]) split[digests[member]].push_back(member);
+        }
+        for (auto& entry : split) {
+            if (entry.second.size() > 1) {
+                result.push_back(std::move(entry.second));
+            } else {
+                loners.push_back(entry.second.front());
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int runDupes(int argc, char* argv[]) {
+    cxxopts::Options options("itfl dupes", "Find files with identical content\n\nUsage:\n itfl dupes [OPTIONS] <dirs...>");
+    options.add_options()
+        ("paths", "Directories (searched recursively) or files", cxxopts::value<std::vector<std::string>>())
+        ("help", "Print usage");
+    addCommonOptions(options);
+    options.parse_positional({"paths"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("paths") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "No directories given. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+    IoStats stats;
+    if (common.statsFormat != StatsFormat::None) {
+        common.read.stats = &stats;
+    }
+    const RunTimer timer;
+    int status = 0;
+
+    std::vector<std::string> errors;
+    const std::vector<WalkEntry> files = walkTrees(result["paths"].as<std::vector<std::string>>(), errors);
+    for (const std::string& error : errors) {
+        std::cerr << color.red << "Error: " << color.reset << error << "\n";
+        status = 1;
+    }
+
+    // Hard links are one file: they take no extra space, so only distinct
+    // inodes (or reflinked extents) count as duplicates of each other
+    PathTable paths;
+    std::size_t pathBytes = 0;
+    for (const WalkEntry& file : files) pathBytes += file.path.size() + 1;
+    paths.reserve(files.size(), pathBytes);
+    for (const WalkEntry& file : files) paths.add(file.path);
+    const SharedPlan shared = planSharing(paths, common.reflinks);
+    const std::vector<std::size_t>& leaders = shared.leaders;
+    std::uint64_t totalBytes = 0;
+    for (std::size_t i : leaders) totalBytes += files[i].size;
+
+    ProgressCounters counters;
+    std::unique_ptr<ProgressReporter> reporter;
+    if (common.progress) {
+        common.read.progress = &counters.bytes;
+        reporter = std::make_unique<ProgressReporter>(counters, 0, 0);
+    }
+    WorkerPool pool(common.jobs, common.topology);
+    std::vector<IoStats> workerStats(pool.size());
+
+    // Pass 1: group by size, members are positions in 'leaders'
+    Pass sizePass, partialPass, fullPass;
+    std::vector<std::vector<std::size_t>> groups, done;
+    {
+        std::map<std::uint64_t, std::vector<std::size_t>> bySize;
+        for (std::size_t k = 0; k < leaders.size(); k++) bySize[files[leaders[k]].size].push_back(k);
+        sizePass.files = leaders.size();
+        for (auto& entry : bySize) {
+            if (entry.second.size() == 1) {
+                sizePass.ruledOut++;
+                sizePass.bytesSaved += entry.first;
+            } else if (entry.first == 0) {
+                // All empty files are the same
+                done.push_back(std::move(entry.second));
+            } else {
+                groups.push_back(std::move(entry.second));
+            }
+        }
+    }
+
+    // Runs 'digest' on every member of every group, in parallel
+    std::vector<char> ok(leaders.size(), 0);
+    auto hashGroups = [&](const std::function<bool(std::size_t, const ReadContext&)>& digest) {
+        std::vector<std::size_t> members;
+        for (const std::vector<std::size_t>& group : groups) members.insert(members.end(), group.begin(), group.end());
+        pool.parallelFor(members.size(), [&](std::size_t i, Worker& worker) {
+            ReadContext ctx = common.read;
+            ctx.node = worker.node;
+            if (ctx.stats) ctx.stats = &workerStats[worker.index];
+            std::size_t member = members[i];
+            ok[member] = digest(member, ctx);
+            counters.files.fetch_add(1, std::memory_order_relaxed);
+        });
+        for (std::size_t member : members) {
+            if (!ok[member]) {
+                if (reporter) reporter->clear();
+                std::cerr << color.red << "Error: " << color.reset << "Could not read file: '" << files[leaders[member]].path << "'.\n";
+                status = 1;
+            }
+        }
+    };
+
+    // Pass 2: first and last PartialBytes
+    std::vector<RawDigest> partial(leaders.size());
+    hashGroups([&](std::size_t member, const ReadContext& ctx) {
+        return partialDigest(files[leaders[member]].path, files[leaders[member]].size, ctx, partial[member]);
+    });
+    {
+        std::vector<std::size_t> loners;
+        std::vector<std::vector<std::size_t>> split = regroup(groups, partial, ok, loners);
+        for (const std::vector<std::size_t>& group : groups) {
+            for (std::size_t member : group) {
+                std::uint64_t size = files[leaders[member]].size;
+                partialPass.files++;
+                partialPass.bytesRead += std::min(size, 2 * PartialBytes);
+            }
+        }
+        for (std::size_t member : loners) {
+            std::uint64_t size = files[leaders[member]].size;
+            partialPass.ruledOut++;
+            partialPass.bytesSaved += size - std::min(size, 2 * PartialBytes);
+        }
+        groups.clear();
+        for (std::vector<std::size_t>& group : split) {
+            // Small files were read whole, their partial digest is the full one
+            if (files[leaders[group.front()]].size <= 2 * PartialBytes) {
+                done.push_back(std::move(group));
+            } else {
+                groups.push_back(std::move(group));
+            }
+        }
+    }
+
+    // Pass 3: everything that still collides, in full
+    std::vector<RawDigest> full(leaders.size());
+    std::fill(ok.begin(), ok.end(), 0);
+    hashGroups([&](std::size_t member, const ReadContext& ctx) {
+        RawFileDigests digests;
+        if (!digestFile(files[leaders[member]].path, DigestRequest(), ctx, digests)) return false;
+        std::memcpy(full[member].data(), digests.sha256, sizeof(digests.sha256));
+        return true;
+    });
+    {
+        std::vector<std::size_t> loners;
+        for (const std::vector<std::size_t>& group : groups) {
+            fullPass.files += group.size();
+            fullPass.bytesRead += files[leaders[group.front()]].size * group.size();
+        }
+        std::vector<std::vector<std::size_t>> split = regroup(groups, full, ok, loners);
+        fullPass.ruledOut = loners.size();
+        for (std::vector<std::size_t>& group : split) done.push_back(std::move(group));
+    }
+    for (const IoStats& workerStat : workerStats) stats.merge(workerStat);
+    reporter.reset();
+
+    // Biggest waste first, then by path
+    std::sort(done.begin(), done.end(), [&](const std::vector<std::size_t>& a, const std::vector<std::size_t>& b) {
+        std::uint64_t sizeA = files[leaders[a.front()]].size, sizeB = files[leaders[b.front()]].size;
+        if (sizeA != sizeB) return sizeA > sizeB;
+        return a.front() < b.front();
+    });
+    std::uint64_t redundant = 0, reclaimable = 0;
+    for (std::size_t g = 0; g < done.size(); g++) {
+        if (g > 0) std::cout << '\n';
+        for (std::size_t member : done[g]) {
+            std::cout << files[leaders[member]].path << '\n';
+            for (std::size_t link : shared.followers[member]) std::cout << files[link].path << '\n';
+        }
+        redundant += done[g].size() - 1;
+        reclaimable += files[leaders[done[g].front()]].size * (done[g].size() - 1);
+    }
+
+    printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+    std::cerr << "itfl: " << leaders.size() << " distinct files, " << totalBytes << " bytes\n"
+              << "itfl: size pass ruled out " << sizePass.ruledOut << " of " << sizePass.files
+              << " without reading (" << sizePass.bytesSaved << " bytes)\n"
+              << "itfl: partial pass read " << partialPass.bytesRead << " bytes of " << partialPass.files
+              << " files, ruled out " << partialPass.ruledOut << " (" << partialPass.bytesSaved << " bytes not read)\n"
+              << "itfl: full pass read " << fullPass.bytesRead << " bytes of " << fullPass.files
+              << " files, ruled out " << fullPass.ruledOut << "\n"
+              << "itfl: " << done.size() << " group(s) of duplicates, " << redundant << " redundant file(s), "
+              << reclaimable << " bytes reclaimable\n";
+    return status;
+}
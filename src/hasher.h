@@ -0,0 +1,72 @@
+// The Hasher concept shared by every digest engine and every I/O backend.
+//
+// A Hasher is any default-constructible type with the interface of
+// lib/sha256.h:
+//
+//   enum { HashBytes = N };
+//   void        reset();
+//   void        add(const void* data, size_t numBytes);
+//   std::string getHash();                       // hex
+//   void        getHash(unsigned char buffer[HashBytes]);
+//
+// Readers are templates over the hasher type, so the per-chunk add() is a
+// direct call the compiler can inline, and no engine needs a vtable.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+template <typename H, typename = void>
+struct is_hasher : std::false_type {};
+
+template <typename H>
+struct is_hasher<H, std::void_t<
+    decltype(std::declval<H&>().reset()),
+    decltype(std::declval<H&>().add(std::declval<const void*>(), std::size_t())),
+    decltype(std::declval<H&>().getHash(std::declval<unsigned char*>())),
+    decltype(static_cast<std::size_t>(H::HashBytes))>>
+    : std::is_convertible<decltype(std::declval<H&>().getHash()), std::string> {};
+
+template <typename H>
+constexpr bool is_hasher_v = is_hasher<H>::value;
+
+// Feeds the same bytes to several hashers, so one pass over a file can
+// produce e.g. a SHA-256 and a CRC-32C. Each member can be switched off at
+// runtime; its add() is then skipped.
+template <typename... Hs>
+class HasherSet {
+    static_assert((is_hasher_v<Hs> && ...), "every member of a HasherSet must be a Hasher");
+
+    public:
+    HasherSet() { enabled.fill(true); }
+
+    template <std::size_t I>
+    auto& get() { return std::get<I>(hashers); }
+
+    template <std::size_t I>
+    void enable(bool on) { enabled[I] = on; }
+
+    template <std::size_t I>
+    bool isEnabled() const { return enabled[I]; }
+
+    void reset() {
+        std::apply([](Hs&... h) { (h.reset(), ...); }, hashers);
+    }
+
+    void add(const void* data, std::size_t numBytes) {
+        addEach(data, numBytes, std::index_sequence_for<Hs...>());
+    }
+
+    private:
+    template <std::size_t... I>
+    void addEach(const void* data, std::size_t numBytes, std::index_sequence<I...>) {
+        ((enabled[I] ? std::get<I>(hashers).add(data, numBytes) : void()), ...);
+    }
+
+    std::tuple<Hs...> hashers;
+    std::array<bool, sizeof...(Hs)> enabled;
+};
@@ -0,0 +1,33 @@
+// Lowercase hex for raw digests, the format of every digest itfl prints
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+inline std::string toHex(const unsigned char* bytes, std::size_t size) {
+    static const char dec2hex[16+1] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(2 * size);
+    for (std::size_t i = 0; i < size; i++) {
+        hex += dec2hex[bytes[i] >> 4];
+        hex += dec2hex[bytes[i] & 15];
+    }
+    return hex;
+}
+
+// Parse exactly 2 * size hex digits, either case. Returns false otherwise.
+inline bool fromHex(const std::string& hex, unsigned char* bytes, std::size_t size) {
+    if (hex.size() != 2 * size) return false;
+    auto nibble = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    for (std::size_t i = 0; i < size; i++) {
+        int high = nibble(hex[2 * i]), low = nibble(hex[2 * i + 1]);
+        if (high < 0 || low < 0) return false;
+        bytes[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+    return true;
+}
@@ -0,0 +1,127 @@
+// itfl identify: look files up in a known-digest index, to tell which
+// release a file belongs to or to scan trees against a blocklist
+#include "../lib/cxxopts.hpp"
+#include "commands.h"
+#include "digest.h"
+#include "digestindex.h"
+#include "options.h"
+#include "pool.h"
+#include "progress.h"
+#include "term.h"
+#include "walk.h"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+int runIdentify(int argc, char* argv[]) {
+    cxxopts::Options options("itfl identify", "Find files in a known-digest index built by 'itfl index build'\n\nUsage:\n itfl identify [OPTIONS] -i <index> <paths...>\n\nPrints every manifest and path each file matches. Directories are searched recursively.");
+    options.add_options()
+        ("i,index", "Index to search", cxxopts::value<std::string>())
+        ("blocklist", "Treat the index as known-bad: only print files that match, and fail if any does")
+        ("paths", "Files or directories", cxxopts::value<std::vector<std::string>>())
+        ("help", "Print usage");
+    addCommonOptions(options);
+    options.parse_positional({"paths"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("index") == 0 || result.count("paths") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "An index and at least one path are required. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+    IoStats stats;
+    if (common.statsFormat != StatsFormat::None) {
+        common.read.stats = &stats;
+    }
+    const bool blocklist = result.count("blocklist");
+    const DigestIndex index(result["index"].as<std::string>());
+    const RunTimer timer;
+    int status = 0;
+
+    std::vector<std::string> errors;
+    const std::vector<WalkEntry> files = walkTrees(result["paths"].as<std::vector<std::string>>(), errors);
+    for (const std::string& error : errors) {
+        std::cerr << color.red << "Error: " << color.reset << error << "\n";
+        status = 1;
+    }
+
+    ProgressCounters counters;
+    std::unique_ptr<ProgressReporter> reporter;
+    if (common.progress) {
+        std::uint64_t totalBytes = 0;
+        for (const WalkEntry& file : files) totalBytes += file.size;
+        common.read.progress = &counters.bytes;
+        reporter = std::make_unique<ProgressReporter>(counters, totalBytes, files.size());
+    }
+
+    struct Result {
+        bool ok = false;
+        std::vector<IndexMatch> matches;
+    };
+    std::vector<Result> results(files.size());
+    std::atomic<std::uint64_t> bloomRejects{0};
+    std::size_t matched = 0, unknown = 0, unreadable = 0;
+
+    OrderedEmitter emitter(files.size(), [&](std::size_t i) {
+        if (reporter) reporter->clear();
+        const Result& file = results[i];
+        if (!file.ok) {
+            std::cerr << color.red << "Error: " << color.reset << "Could not read file: '" << files[i].path << "'.\n";
+            unreadable++;
+            return;
+        }
+        if (file.matches.empty()) {
+            unknown++;
+            if (!blocklist) std::cout << files[i].path << ": " << color.red << "unknown" << color.reset << '\n';
+            return;
+        }
+        matched++;
+        for (const IndexMatch& match : file.matches) {
+            std::cout << files[i].path << ": ";
+            if (blocklist) std::cout << color.red << "BLOCKED " << color.reset;
+            std::cout << match.source << "  " << match.path << '\n';
+        }
+    });
+
+    WorkerPool pool(common.jobs, common.topology);
+    std::vector<IoStats> workerStats(pool.size());
+    pool.parallelFor(files.size(), [&](std::size_t i, Worker& worker) {
+        ReadContext ctx = common.read;
+        ctx.node = worker.node;
+        if (ctx.stats) ctx.stats = &workerStats[worker.index];
+        RawFileDigests digests;
+        results[i].ok = digestFile(files[i].path, DigestRequest(), ctx, digests);
+        if (results[i].ok) {
+            bool ruledOut = false;
+            results[i].matches = index.find(digests.sha256, &ruledOut);
+            if (ruledOut) bloomRejects.fetch_add(1, std::memory_order_relaxed);
+        }
+        counters.files.fetch_add(1, std::memory_order_relaxed);
+        emitter.done(i);
+    });
+    for (const IoStats& workerStat : workerStats) stats.merge(workerStat);
+
+    reporter.reset();
+    printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+    std::cerr << "itfl: " << files.size() << " file(s) against " << index.size() << " known digests: "
+              << matched << " matched, " << unknown << " unknown";
+    if (index.hasBloom()) std::cerr << " (" << bloomRejects.load() << " ruled out by the Bloom filter)";
+    std::cerr << '\n';
+
+    if (unreadable > 0 || (blocklist ? matched > 0 : unknown > 0)) status = 1;
+    return status;
+}
@@ -0,0 +1,82 @@
+// itfl index build: turn manifests of known files into a digest index that
+// 'itfl identify' maps and searches without parsing anything
+#include "../lib/cxxopts.hpp"
+#include "binmanifest.h"
+#include "commands.h"
+#include "digestindex.h"
+#include "hex.h"
+#include "manifest.h"
+#include "term.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int runIndex(int argc, char* argv[]) {
+    cxxopts::Options options("itfl index build", "Build a known-digest index from manifests\n\nUsage:\n itfl index build [OPTIONS] -o <index> <manifests...>\n\nEach manifest names a set of known files, such as one release. 'itfl identify' reports the manifest and path of every match.");
+    options.add_options()
+        ("o,output", "Index file to write", cxxopts::value<std::string>())
+        ("bloom", "Bloom filter bits per entry, 0 for none", cxxopts::value<unsigned>()->default_value("10"))
+        ("manifests", "Manifests to index", cxxopts::value<std::vector<std::string>>())
+        ("help", "Print usage");
+    options.parse_positional({"manifests"});
+
+    const TerminalColor color;
+
+    if (argc < 2 || std::strcmp(argv[1], "build") != 0) {
+        if (argc >= 2 && std::strcmp(argv[1], "--help") == 0) {
+            std::cout << options.help() << std::endl;
+            return 0;
+        }
+        std::cerr << color.red << "Error: " << color.reset << "Unknown index command. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+    auto result = options.parse(argc - 1, argv + 1);
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("output") == 0 || result.count("manifests") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "An output file and at least one manifest are required. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+    const unsigned bloomBits = result["bloom"].as<unsigned>();
+    if (bloomBits > 64) {
+        std::cerr << color.red << "Error: " << color.reset << "Invalid --bloom: " << bloomBits << " (at most 64 bits per entry)\n";
+        return 1;
+    }
+
+    std::vector<IndexSource> sources;
+    std::size_t entries = 0, withoutSha256 = 0;
+    for (const std::string& manifestName : result["manifests"].as<std::vector<std::string>>()) {
+        std::ifstream manifestStream(manifestName);
+        if (!manifestStream) {
+            std::cerr << color.red << "Error: " << color.reset << "Could not open manifest: '" << manifestName << "'.\n";
+            return 1;
+        }
+        IndexSource source;
+        source.name = manifestName;
+        for (ManifestEntry& entry : loadManifest(manifestName)) {
+            RawDigest digest;
+            if (!fromHex(entry.sha256, digest.data(), digest.size())) {
+                withoutSha256++;
+                continue;
+            }
+            source.entries.emplace_back(digest, std::move(entry.path));
+        }
+        entries += source.entries.size();
+        sources.push_back(std::move(source));
+    }
+
+    const std::string output = result["output"].as<std::string>();
+    std::size_t records = buildDigestIndex(output, sources, bloomBits);
+    std::cerr << "itfl: indexed " << records << " entries from " << sources.size() << " manifest(s) into '" << output << "'";
+    if (records < entries) std::cerr << ", " << entries - records << " repeated";
+    if (withoutSha256 > 0) std::cerr << ", " << withoutSha256 << " skipped without a SHA-256";
+    std::cerr << '\n';
+    return 0;
+}
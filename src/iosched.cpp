@@ -0,0 +1,100 @@
+#include "iosched.h"
+
+#include "device.h"
+
+#include <map>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+DeviceScheduler::DeviceScheduler(const PathTable& paths, const BatchPlan& plan, std::size_t perRotational, std::size_t perSolid)
+    : groups(1), groupOf(plan.order.size(), 0) {
+#ifndef _WIN32
+    // One describeDevice() per st_dev, one group per disk
+    std::map<dev_t, std::uint32_t> byDevice;
+    std::map<std::string, std::uint32_t> byDisk;
+    for (std::size_t position = plan.resident; position < plan.order.size(); position++) {
+        struct stat st;
+        if (::stat(paths.c_str(plan.order[position]), &st) != 0) continue;
+        auto known = byDevice.find(st.st_dev);
+        if (known == byDevice.end()) {
+            std::uint32_t group = 0;
+            DeviceInfo device = describeDevice(st.st_dev);
+            if (device.known) {
+                auto disk = byDisk.find(device.disk);
+                if (disk != byDisk.end()) {
+                    group = disk->second;
+                } else {
+                    group = static_cast<std::uint32_t>(groups.size());
+                    groups.emplace_back();
+                    groups.back().limit = device.rotational ? perRotational : perSolid;
+                    groups.back().limited = groups.back().limit != 0;
+                    if (groups.back().limit > startLimit) startLimit = groups.back().limit;
+                    if (device.rotational) rotational++;
+                    byDisk.emplace(device.disk, group);
+                }
+            }
+            known = byDevice.emplace(st.st_dev, group).first;
+        }
+        groupOf[position] = known->second;
+    }
+#else
+    (void)paths;
+    (void)perRotational;
+    (void)perSolid;
+#endif
+    for (std::size_t position = 0; position < groupOf.size(); position++) {
+        groups[groupOf[position]].pending.push_back(position);
+    }
+}
+
+std::size_t DeviceScheduler::take() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        Group* best = nullptr;
+        if (limit != 0 && active >= limit) {
+            wake.wait(guard);
+            continue;
+        }
+        for (Group& group : groups) {
+            if (group.pending.empty() || (group.limit != 0 && group.active >= group.limit)) continue;
+            if (best == nullptr || group.pending.front() < best->pending.front()) best = &group;
+        }
+        if (best != nullptr) {
+            std::size_t position = best->pending.front();
+            best->pending.pop_front();
+            best->active++;
+            active++;
+            return position;
+        }
+        wake.wait(guard);
+    }
+}
+
+void DeviceScheduler::finished(std::size_t position) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        groups[groupOf[position]].active--;
+        active--;
+    }
+    wake.notify_one();
+}
+
+void DeviceScheduler::setLimit(std::size_t files) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        limit = files;
+    }
+    wake.notify_all();
+}
+
+void DeviceScheduler::setDiskLimit(std::size_t files) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (Group& group : groups) {
+            if (group.limited) group.limit = files;
+        }
+    }
+    wake.notify_all();
+}
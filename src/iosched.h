@@ -0,0 +1,70 @@
+// Per-disk admission for commands that hash many files.
+//
+// A flat pool that hands every worker the next file puts several seeking
+// readers on one spinning disk while the other disks of the batch sit idle.
+// Here files are grouped by the disk under them (partitions of one disk
+// share it), each disk takes a set number of reads at a time, and a free
+// worker picks the earliest file in plan order whose disk has room. Hashing
+// still runs on the shared WorkerPool; only the order files are picked up
+// in changes. Files in the page cache, and files on anything that is not a
+// known block device, are never held back.
+#pragma once
+
+#include "prefetch.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class DeviceScheduler {
+    public:
+    // Allow 'perRotational' reads at a time on a spinning disk and
+    // 'perSolid' on any other disk, 0 for no limit. Stats every file.
+    DeviceScheduler(const PathTable& paths, const BatchPlan& plan, std::size_t perRotational, std::size_t perSolid);
+
+    DeviceScheduler(const DeviceScheduler&) = delete;
+    DeviceScheduler& operator=(const DeviceScheduler&) = delete;
+
+    // Wait until some file of the plan can be read within its disk's limit,
+    // and return its position in plan.order. Call once per file.
+    std::size_t take();
+    // The file taken at this position is done
+    void finished(std::size_t position);
+    // Files read at a time over all disks, 0 for no limit
+    void setLimit(std::size_t files);
+    // Reads at a time on every disk that started with a limit; disks
+    // without one stay unlimited
+    void setDiskLimit(std::size_t files);
+    // The highest limit a disk of the batch started with, 0 if none has one
+    std::size_t diskLimit() const { return startLimit; }
+
+    // Disks the batch spans, and how many of them spin
+    std::size_t disks() const { return groups.size() - 1; }
+    std::size_t rotationalDisks() const { return rotational; }
+
+    private:
+    struct Group {
+        // Reads allowed at a time, 0 for no limit
+        std::size_t limit = 0;
+        bool limited = false;
+        std::size_t active = 0;
+        // Positions not taken yet, in plan order
+        std::deque<std::size_t> pending;
+    };
+
+    // Group 0 is the unlimited one
+    std::vector<Group> groups;
+    // Group of every position in plan.order
+    std::vector<std::uint32_t> groupOf;
+    std::size_t rotational = 0;
+    std::size_t startLimit = 0;
+    std::size_t limit = 0;
+    std::size_t active = 0;
+
+    std::mutex lock;
+    std::condition_variable wake;
+};
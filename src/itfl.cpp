@@ -29,93 +29,63 @@
 
 */
 #include "../lib/cxxopts.hpp"
-#include "../lib/sha256.h"
-#include <fstream>
+#include "algorithms.h"
+#include "commands.h"
+#include "options.h"
+#include "pool.h"
+#include "progress.h"
+#include "term.h"
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
-#include <array>
-
-// Windows specific imports, for color right now
-#ifdef _WIN32
-#include <windows.h>
-#include <io.h>
-#define IS_TTY _isatty
-#define FILENO _fileno
-#else
-#include <unistd.h>
-#define IS_TTY isatty
-#define FILENO fileno
-#endif
-
-// To manage terminal colors
-class TerminalColor {
-    public:
-    const std::string red;
-    const std::string green;
-    const std::string blue;
-    const std::string reset;
-
-    // Set the ansi codes if the term isnt a TTY. Logic is in the private func
-    TerminalColor() :
-        red(colorSupport() ? "\033[31m" : ""),
-        green(colorSupport() ? "\033[32m" : ""),
-        blue(colorSupport() ? "\033[34m" : ""),
-        reset(colorSupport() ? "\033[0m" : "")
-    {}
-    
-    private:
-    bool colorSupport() const {
-        #ifdef _WIN32
-        // For now, just use normal text if user is on Windows.
-        return false;
-        #else
-        return IS_TTY(FILENO(stdout));
-        #endif
-    }
-};
-
-// Given a file stream, return it's SHA256 hash using a buffer based approach
-std::string getHash(std::ifstream& file_stream) {
-    // Get a hasher object
-    SHA256 sha256;
-
-    // Buffer of size 256KB
-    std::array<char, 262144> buf;
-
-    // Read full buffers until eofbit and failbit are set by file_stream.read()
-    // eofbit set when end of file is hit
-    // This also triggers failbit because full read request was not completed
-    // This will make the while loop evaluate to false
-    // Process the read buffers
-    std::streamsize bytesRead;
-    while (file_stream.read(buf.data(), buf.size())) {
-        bytesRead = file_stream.gcount();
-        sha256.add(buf.begin() ,bytesRead);
-    }
 
-    // See if there were more than 0 bytes read at the end, when there's not a full buffer left
-    // If so, process those bytes too
-    bytesRead = file_stream.gcount();
-    if (bytesRead > 0) {
-        sha256.add(buf.begin(), bytesRead);
-    }
-    std::string computedHash = sha256.getHash();
+// Subcommands. Anything else on the command line is the classic
+// 'itfl <filename> <hash>' form.
+struct Command {
+    const char* name;
+    int (*run)(int argc, char* argv[]);
+};
 
-    return computedHash;
-}
+const Command commands[] = {
+    {"sum", runSum},
+    {"check", runCheck},
+    {"bench", runBench},
+    {"dupes", runDupes},
+    {"tar", runTar},
+    {"chunks", runChunks},
+    {"index", runIndex},
+    {"identify", runIdentify},
+    {"watch", runWatch},
+    {"convert", runConvert},
+    {"diff", runDiff},
+};
 
 int main(int argc, char* argv[]) {
 
     try {
-        cxxopts::Options options("itfl", "A lightweight command-line utility for SHA-256 file integrity verification \n\nUsage:\n itfl [OPTIONS] <filename> <hash>");
+        if (argc > 1) {
+            for (const Command& command : commands) {
+                if (std::strcmp(argv[1], command.name) == 0) {
+                    return command.run(argc - 1, argv + 1);
+                }
+            }
+        }
+
+        cxxopts::Options options("itfl", "A lightweight command-line utility for SHA-256 file integrity verification \n\nUsage:\n itfl [OPTIONS] <filename> <hash>\n itfl sum [OPTIONS] <files...>\n itfl check [OPTIONS] <manifest>\n itfl bench [OPTIONS]\n itfl dupes [OPTIONS] <dirs...>\n itfl tar [OPTIONS] [archive]\n itfl chunks [OPTIONS] <files...>\n itfl index build [OPTIONS] -o <index> <manifests...>\n itfl identify [OPTIONS] -i <index> <paths...>\n itfl watch [OPTIONS] <dirs...>\n itfl convert [OPTIONS] <manifest>\n itfl diff [OPTIONS] <old> <new>");
         options.add_options()
             ("v,verbose", "Enable verbose output")
             ("f,filename", "File to process", cxxopts::value<std::string>())
             ("h,hash", "SHA-256 hash to check against", cxxopts::value<std::string>())
+            ("a,algorithm", "Digest algorithm: " + algorithmNames(), cxxopts::value<std::string>()->default_value("sha256"))
+            ("offset", "Start hashing at this byte (K, M, G suffixes)", cxxopts::value<std::string>())
+            ("length", "Hash only this many bytes (K, M, G suffixes)", cxxopts::value<std::string>())
             ("version", "Print version information")
             ("help", "Print usage");
 
+        addCommonOptions(options);
+
         // Filename and hash can be given anywhere without a flag, so parse them in this order
         options.parse_positional({"filename", "hash"});
 
@@ -149,35 +119,81 @@ int main(int argc, char* argv[]) {
         const std::string filename = result["filename"].as<std::string>();
         const std::string givenHash = result["hash"].as<std::string>();
         
-        if (givenHash.length() != 64) {
-            std::cerr << color.red << "Error: " << color.reset << "Invalid length for given hash string\n";
+        const Algorithm* algorithm = findAlgorithm(result["algorithm"].as<std::string>());
+        if (algorithm == nullptr) {
+            std::cerr << color.red << "Error: " << color.reset << "Unknown algorithm, expected one of: " << algorithmNames() << "\n";
             return 1;
         }
 
-        // Read the file's contents in binary mode
-        std::ifstream file_stream(filename, std::ios::binary);
-        if (!file_stream) {
-            std::cerr << color.red << "Error: " << color.reset << "Could not open file: '" << filename << "'.\n";
+        CommonOptions common;
+        if (!parseCommonOptions(result, common)) {
+            return 1;
+        }
+        IoStats stats;
+        if (common.statsFormat != StatsFormat::None) {
+            common.read.stats = &stats;
+        }
+        const RunTimer timer;
+
+        if (givenHash.length() != 2 * algorithm->hashBytes) {
+            std::cerr << color.red << "Error: " << color.reset << "Invalid length for given hash string\n";
             return 1;
         }
 
-        // This vector based approach is inefficient. Just hashing a 1.5Gig file scaled to 1MB :/
-        // TODO: switch to a buffer based approach
+        // A region of a file or device, e.g. one firmware partition
+        std::uint64_t size = fileSize(filename);
+        for (const char* bound : {"offset", "length"}) {
+            if (result.count(bound) == 0) continue;
+            std::uint64_t bytes = 0;
+            if (!parseSize(result[bound].as<std::string>(), bytes)) {
+                std::cerr << color.red << "Error: " << color.reset << "Invalid --" << bound << ": '" << result[bound].as<std::string>() << "'\n";
+                return 1;
+            }
+            (std::strcmp(bound, "offset") == 0 ? common.read.offset : common.read.length) = bytes;
+        }
+        if (common.read.ranged() && common.read.backend == Backend::Stream) {
+            std::cerr << color.red << "Error: " << color.reset << "--offset and --length need a file that can be read at an offset; use an --io other than stream\n";
+            return 1;
+        }
+        std::uint64_t rangeOffset = 0, rangeLength = size;
+        // Size 0 may just mean unreadable, which hashing reports below
+        if (common.read.ranged() && size > 0 && !resolveRange(common.read, size, rangeOffset, rangeLength)) {
+            std::cerr << color.red << "Error: " << color.reset << "Range is outside of '" << filename << "' (" << size << " bytes)\n";
+            return 1;
+        }
 
-        // Create a vector that'll store the hashed value in bytes (??)
-        // std::vector<unsigned char> s(picosha2::k_digest_size);
-        // picosha2::hash256(file_stream, s.begin(), s.end());
+        // Only tree digests can split one file over several workers
+        std::unique_ptr<WorkerPool> pool;
+        if (common.jobs > 1 && algorithm->splitsFiles) {
+            pool = std::make_unique<WorkerPool>(common.jobs, common.topology);
+            common.read.pool = pool.get();
+        }
 
-        // // Bytes to the actual string
-        // std::string computedHash = picosha2::bytes_to_hex_string(s.begin(), s.end());
+        ProgressCounters counters;
+        std::unique_ptr<ProgressReporter> reporter;
+        if (common.progress) {
+            common.read.progress = &counters.bytes;
+            reporter = std::make_unique<ProgressReporter>(counters, rangeLength, 1);
+        }
 
-        std::string computedHash = getHash(file_stream);
+        std::string computedHash;
+        bool hashed = algorithm->hashFile(filename, common.read, computedHash);
+        reporter.reset();
+        if (!hashed) {
+            std::cerr << color.red << "Error: " << color.reset << "Could not open file: '" << filename << "'.\n";
+            return 1;
+        }
 
         if (verbose) {
-            std::cout << "Calculated SHA-256 hash of " << filename << ": " << computedHash << std::endl;
+            std::cout << "Calculated " << algorithm->name << " hash of " << filename << ": " << computedHash << std::endl;
             std::cout << "Given hash: " << givenHash << std::endl;
+            if (common.throttle) {
+                std::cout << "Throttled for " << common.throttle->throttledNs() / 1000000 << " ms by --max-rate" << std::endl;
+            }
         }
 
+        printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+
         if (computedHash == givenHash) {
             std::cout << color.green << "Hash check passed!" << color.reset << " Given file matches hash provided" << std::endl;
         } else {
@@ -187,6 +203,9 @@ int main(int argc, char* argv[]) {
         // If anything occurs, deviate from the happy little path
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
     }
     return 0;
 }
\ No newline at end of file
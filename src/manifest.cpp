@@ -0,0 +1,273 @@
+#include "manifest.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+bool isHex(const std::string& s) {
+    for (char c : s) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return !s.empty();
+}
+
+std::string toLower(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+bool parseUnsigned(const std::string& text, std::uint64_t& value) {
+    if (text.empty() || text.size() > 19) return false;
+    value = 0;
+    for (char c : text) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) return false;
+        value = value * 10 + static_cast<std::uint64_t>(c - '0');
+    }
+    return true;
+}
+
+// "<seconds>.<nanoseconds>", seconds possibly negative, always nine digits after the dot
+bool parseMtime(const std::string& text, std::int64_t& ns) {
+    bool negative = !text.empty() && text[0] == '-';
+    std::size_t dot = text.find('.');
+    std::uint64_t seconds = 0, fraction = 0;
+    if (dot == std::string::npos || text.size() - dot - 1 != 9) return false;
+    if (!parseUnsigned(text.substr(negative, dot - negative), seconds) || !parseUnsigned(text.substr(dot + 1), fraction)) return false;
+    if (seconds > 9000000000ull) return false;
+    std::int64_t whole = static_cast<std::int64_t>(seconds) * 1000000000;
+    ns = negative ? -whole - static_cast<std::int64_t>(fraction) : whole + static_cast<std::int64_t>(fraction);
+    return true;
+}
+
+// Bytes handed to the stream at once by a ManifestWriter
+constexpr std::size_t WriterBufferSize = 64 * 1024;
+
+// "<seconds>.<nanoseconds>" as parseMtime() reads it
+int formatMtime(char* text, std::size_t size, std::int64_t mtimeNs) {
+    std::int64_t seconds = mtimeNs / 1000000000, fraction = mtimeNs % 1000000000;
+    return std::snprintf(text, size, "%s%lld.%09lld", mtimeNs < 0 ? "-" : "",
+                         static_cast<long long>(seconds < 0 ? -seconds : seconds), static_cast<long long>(fraction < 0 ? -fraction : fraction));
+}
+
+// Which of size: and mtime: a line had
+enum StatField { SizeField = 1, MtimeField = 2 };
+
+// Fill in one digest field from a token. Returns false if the token is not recognised.
+bool parseField(const std::string& token, ManifestEntry& entry, unsigned& statFields) {
+    if (token.size() == 64 && isHex(token)) {
+        entry.sha256 = toLower(token);
+        return true;
+    }
+    const std::string crcPrefix = "crc32c:";
+    if (token.compare(0, crcPrefix.size(), crcPrefix) == 0) {
+        std::string value = token.substr(crcPrefix.size());
+        if (value.size() != 8 || !isHex(value)) return false;
+        entry.crc32c = toLower(value);
+        return true;
+    }
+    // size: and mtime: come together; readManifest checks that both did
+    const std::string sizePrefix = "size:", mtimePrefix = "mtime:";
+    if (token.compare(0, sizePrefix.size(), sizePrefix) == 0) {
+        statFields |= SizeField;
+        return parseUnsigned(token.substr(sizePrefix.size()), entry.size);
+    }
+    if (token.compare(0, mtimePrefix.size(), mtimePrefix) == 0) {
+        statFields |= MtimeField;
+        return parseMtime(token.substr(mtimePrefix.size()), entry.mtimeNs);
+    }
+    return false;
+}
+
+} // namespace
+
+bool ManifestReader::next(ManifestEntry& entry) {
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        entry = ManifestEntry();
+        unsigned statFields = 0;
+        const bool escaped = line[0] == '\\';
+        std::size_t pos = escaped ? 1 : 0;
+        bool done = false;
+        while (!done) {
+            std::size_t end = line.find(' ', pos);
+            if (end == std::string::npos || !parseField(line.substr(pos, end - pos), entry, statFields)) {
+                throw std::runtime_error("manifest line " + std::to_string(lineNumber) + " is malformed");
+            }
+            // Two spaces (text mode) or " *" (binary mode) start the path
+            if (end + 1 < line.size() && (line[end + 1] == ' ' || line[end + 1] == '*')) {
+                entry.binaryMode = line[end + 1] == '*';
+                entry.path = line.substr(end + 2);
+                done = true;
+            } else {
+                pos = end + 1;
+            }
+        }
+
+        if (escaped && !unescapeManifestPath(entry.path)) {
+            throw std::runtime_error("manifest line " + std::to_string(lineNumber) + " has a malformed escape");
+        }
+        if (entry.path.empty()) {
+            throw std::runtime_error("manifest line " + std::to_string(lineNumber) + " has no path");
+        }
+        if (statFields != 0 && statFields != (SizeField | MtimeField)) {
+            throw std::runtime_error("manifest line " + std::to_string(lineNumber) + " has only one of size: and mtime:");
+        }
+        entry.hasStat = statFields != 0;
+        return true;
+    }
+    return false;
+}
+
+std::vector<ManifestEntry> readManifest(std::istream& in) {
+    std::vector<ManifestEntry> entries;
+    ManifestReader reader(in);
+    ManifestEntry entry;
+    while (reader.next(entry)) entries.push_back(std::move(entry));
+    return entries;
+}
+
+bool manifestPathNeedsEscape(std::string_view path) {
+    return path.find_first_of("\\\n\r") != std::string_view::npos;
+}
+
+std::string escapeManifestPath(std::string_view path) {
+    std::string escaped;
+    escaped.reserve(path.size() + 8);
+    for (char c : path) {
+        switch (c) {
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+bool unescapeManifestPath(std::string& path) {
+    std::size_t out = 0;
+    for (std::size_t i = 0; i < path.size(); i++) {
+        char c = path[i];
+        if (c == '\\') {
+            if (++i == path.size()) return false;
+            switch (path[i]) {
+            case '\\': c = '\\'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            default: return false;
+            }
+        }
+        path[out++] = c;
+    }
+    path.resize(out);
+    return true;
+}
+
+void writeManifestEntry(std::ostream& out, const ManifestEntry& entry) {
+    const bool escape = manifestPathNeedsEscape(entry.path);
+    if (escape) out << '\\';
+    out << entry.sha256;
+    if (!entry.crc32c.empty()) out << " crc32c:" << entry.crc32c;
+    if (entry.hasStat) {
+        char mtime[40];
+        formatMtime(mtime, sizeof(mtime), entry.mtimeNs);
+        out << " size:" << entry.size << " mtime:" << mtime;
+    }
+    out << (entry.binaryMode ? " *" : "  ") << (escape ? escapeManifestPath(entry.path) : entry.path) << '\n';
+}
+
+ManifestWriter::ManifestWriter(std::ostream& out) : out(out), buffer(WriterBufferSize) {}
+
+ManifestWriter::~ManifestWriter() {
+    flush();
+}
+
+void ManifestWriter::append(const char* data, std::size_t size) {
+    if (used + size > buffer.size()) {
+        flush();
+        // A path longer than the whole buffer goes straight through
+        if (size > buffer.size()) {
+            out.write(data, static_cast<std::streamsize>(size));
+            return;
+        }
+    }
+    std::memcpy(buffer.data() + used, data, size);
+    used += size;
+}
+
+void ManifestWriter::write(const RawManifestEntry& entry) {
+    static const char dec2hex[16+1] = "0123456789abcdef";
+    // Everything but the path fits in here
+    char line[192];
+    std::size_t length = 0;
+    const bool escape = manifestPathNeedsEscape(entry.path);
+    if (escape) line[length++] = '\\';
+    if (entry.sha256) {
+        for (std::size_t i = 0; i < 32; i++) {
+            line[length++] = dec2hex[entry.sha256[i] >> 4];
+            line[length++] = dec2hex[entry.sha256[i] & 15];
+        }
+    }
+    if (entry.crc32c) {
+        std::memcpy(line + length, " crc32c:", 8);
+        length += 8;
+        for (std::size_t i = 0; i < 4; i++) {
+            line[length++] = dec2hex[entry.crc32c[i] >> 4];
+            line[length++] = dec2hex[entry.crc32c[i] & 15];
+        }
+    }
+    if (entry.hasStat) {
+        length += static_cast<std::size_t>(std::snprintf(line + length, sizeof(line) - length, " size:%llu mtime:", static_cast<unsigned long long>(entry.size)));
+        length += static_cast<std::size_t>(formatMtime(line + length, sizeof(line) - length, entry.mtimeNs));
+    }
+    line[length++] = ' ';
+    line[length++] = entry.binaryMode ? '*' : ' ';
+    append(line, length);
+    if (escape) {
+        const std::string escaped = escapeManifestPath(entry.path);
+        append(escaped.data(), escaped.size());
+    } else {
+        append(entry.path.data(), entry.path.size());
+    }
+    append("\n", 1);
+}
+
+void ManifestWriter::flush() {
+    if (used == 0) return;
+    out.write(buffer.data(), static_cast<std::streamsize>(used));
+    used = 0;
+}
+
+VerdictWriter::VerdictWriter(std::ostream& out) : out(out) {
+    buffer.reserve(WriterBufferSize);
+}
+
+VerdictWriter::~VerdictWriter() {
+    flush();
+}
+
+void VerdictWriter::write(std::string_view path, const std::string& color, const char* verdict, const std::string& reset) {
+    if (manifestPathNeedsEscape(path)) {
+        buffer += '\\';
+        buffer += escapeManifestPath(path);
+    } else {
+        buffer += path;
+    }
+    buffer += ": ";
+    buffer += color;
+    buffer += verdict;
+    buffer += reset;
+    buffer += '\n';
+    if (buffer.size() >= WriterBufferSize) flush();
+}
+
+void VerdictWriter::flush() {
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+}
@@ -0,0 +1,113 @@
+// Text manifests: one line per file, compatible with sha256sum output
+//
+//   <sha256>  <path>
+//   <sha256> crc32c:<crc>  <path>
+//   <sha256> size:<bytes> mtime:<seconds>.<nanoseconds>  <path>
+//
+// Extra digests and metadata go between the SHA-256 and the two-space
+// separator so that plain sha256sum files are valid manifests too. As in
+// sha256sum, a path holding a backslash, newline or carriage return is
+// written with those as \\, \n and \r, and its line starts with a backslash.
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ManifestEntry {
+    std::string path;
+    // Lowercase hex, empty when the manifest does not carry it
+    std::string sha256;
+    std::string crc32c;
+    // Size and modification time when the file was hashed, if recorded
+    bool hasStat = false;
+    std::uint64_t size = 0;
+    std::int64_t mtimeNs = 0;
+    // sha256sum -b marks the path with '*' instead of a second space
+    bool binaryMode = false;
+};
+
+// Parse a whole manifest. Blank lines and lines starting with '#' are skipped.
+// Throws std::runtime_error naming the offending line if one is malformed.
+std::vector<ManifestEntry> readManifest(std::istream& in);
+
+// Reads a manifest one entry at a time, for manifests too large to hold
+class ManifestReader {
+    public:
+    explicit ManifestReader(std::istream& in) : in(in) {}
+
+    // The next entry, false at the end. Throws like readManifest().
+    bool next(ManifestEntry& entry);
+
+    private:
+    std::istream& in;
+    std::string line;
+    std::size_t lineNumber = 0;
+};
+
+// Write one entry in the format readManifest() accepts
+void writeManifestEntry(std::ostream& out, const ManifestEntry& entry);
+
+// Whether a path has to be escaped, and the escaped form
+bool manifestPathNeedsEscape(std::string_view path);
+std::string escapeManifestPath(std::string_view path);
+// Undo escapeManifestPath() in place. Returns false on an unknown escape.
+bool unescapeManifestPath(std::string& path);
+
+// An entry as raw fields pointing into storage owned by someone else, so
+// batches do not need a ManifestEntry and two hex strings per file
+struct RawManifestEntry {
+    std::string_view path;
+    // 32 bytes, or nullptr when there is none
+    const unsigned char* sha256 = nullptr;
+    // 4 bytes big endian, or nullptr
+    const unsigned char* crc32c = nullptr;
+    bool hasStat = false;
+    std::uint64_t size = 0;
+    std::int64_t mtimeNs = 0;
+    bool binaryMode = false;
+};
+
+// Writes the same lines as writeManifestEntry(), formatted straight into a
+// buffer that goes to the stream in large blocks
+class ManifestWriter {
+    public:
+    explicit ManifestWriter(std::ostream& out);
+    ~ManifestWriter();
+
+    ManifestWriter(const ManifestWriter&) = delete;
+    ManifestWriter& operator=(const ManifestWriter&) = delete;
+
+    void write(const RawManifestEntry& entry);
+    void flush();
+
+    private:
+    void append(const char* data, std::size_t size);
+
+    std::ostream& out;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+};
+
+// "path: VERDICT" lines of check and tar -c, collected into large writes
+// like ManifestWriter does with manifest lines. Paths are escaped the way
+// the manifest has them.
+class VerdictWriter {
+    public:
+    explicit VerdictWriter(std::ostream& out);
+    ~VerdictWriter();
+
+    VerdictWriter(const VerdictWriter&) = delete;
+    VerdictWriter& operator=(const VerdictWriter&) = delete;
+
+    // 'color' and 'reset' go around the verdict, empty without a terminal
+    void write(std::string_view path, const std::string& color, const char* verdict, const std::string& reset);
+    void flush();
+
+    private:
+    std::ostream& out;
+    std::string buffer;
+};
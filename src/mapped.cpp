@@ -0,0 +1,47 @@
+#include "mapped.h"
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+MappedFile::MappedFile(const std::string& filename, const char* what) {
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("could not open " + std::string(what) + " '" + filename + "'");
+    }
+    length = static_cast<std::size_t>(st.st_size);
+    // mmap() refuses empty files; they are simply empty here
+    if (length > 0) {
+        void* map = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("could not map " + std::string(what) + " '" + filename + "'");
+        }
+        bytes = static_cast<const unsigned char*>(map);
+    }
+    ::close(fd);
+#else
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) throw std::runtime_error("could not open " + std::string(what) + " '" + filename + "'");
+    copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    bytes = copy.data();
+    length = copy.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (bytes) munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+}
@@ -0,0 +1,27 @@
+// A whole file mapped read-only, for the binary formats that are queried
+// in place instead of parsed (digest indexes, binary manifests)
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MappedFile {
+    public:
+    // Throws std::runtime_error naming 'what' ("index", "manifest") if the
+    // file cannot be opened or mapped
+    MappedFile(const std::string& filename, const char* what);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+    private:
+    const unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+    // Where there is no mmap(), the whole file read into memory
+    std::vector<unsigned char> copy;
+};
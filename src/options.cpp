@@ -0,0 +1,140 @@
+#include "options.h"
+
+#include "bufpool.h"
+#include "term.h"
+
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+
+void addCommonOptions(cxxopts::Options& options) {
+    options.add_options()
+        ("io", "I/O backend: auto, read, pread, mmap, direct, sparse, pipelined or stream", cxxopts::value<std::string>()->default_value("auto"))
+        ("stats", "Report time spent per phase on stderr, as text or json (--stats=json; a separate word is taken as a file)", cxxopts::value<std::string>()->implicit_value("text"))
+        ("progress", "Show progress, throughput and ETA on stderr")
+        ("max-rate", "Read at most this many bytes per second (K, M, G suffixes)", cxxopts::value<std::string>())
+        ("idle", "Use the idle I/O and CPU scheduling classes")
+        ("j,jobs", "Worker threads, 0 for one per usable CPU", cxxopts::value<std::size_t>()->default_value("1"))
+        ("tune", "Batches: keep as many workers busy as gives the best measured throughput; without -j, up to one per usable CPU and at least 4")
+        ("cpus", "Only run workers on these CPUs, e.g. 0-7,16-23", cxxopts::value<std::string>())
+        ("mem-budget", "Memory for read buffers, shared by all workers", cxxopts::value<std::string>()->default_value("64M"))
+        ("no-huge-pages", "Back read buffers with normal pages")
+        ("no-prefetch", "Hash files in the given order without reading ahead")
+        ("reflinks", "Hash reflink copies (identical extents) only once")
+        ("hdd-readers", "Files read at a time per spinning disk, 0 for no limit", cxxopts::value<std::size_t>()->default_value("1"))
+        ("ssd-readers", "Files read at a time per other disk, 0 for no limit", cxxopts::value<std::size_t>()->default_value("0"));
+}
+
+bool parseCommonOptions(const cxxopts::ParseResult& result, CommonOptions& common) {
+    const TerminalColor color;
+
+    const std::string backend = result["io"].as<std::string>();
+    if (!parseBackend(backend, common.read.backend)) {
+        std::cerr << color.red << "Error: " << color.reset << "Unknown I/O backend: '" << backend << "'\n";
+        return false;
+    }
+
+    if (result.count("stats")) {
+        const std::string format = result["stats"].as<std::string>();
+        if (!parseStatsFormat(format, common.statsFormat)) {
+            std::cerr << color.red << "Error: " << color.reset << "--stats must be 'text' or 'json'\n";
+            return false;
+        }
+    }
+    common.progress = result.count("progress");
+
+    if (result.count("max-rate")) {
+        std::uint64_t rate = 0;
+        if (!parseSize(result["max-rate"].as<std::string>(), rate) || rate == 0) {
+            std::cerr << color.red << "Error: " << color.reset << "Invalid --max-rate: '" << result["max-rate"].as<std::string>() << "'\n";
+            return false;
+        }
+        common.throttle = std::make_unique<Throttle>(rate);
+        common.read.throttle = common.throttle.get();
+    }
+
+    common.topology = CpuTopology::detect();
+    if (result.count("cpus")) {
+        std::vector<int> allowed;
+        if (!parseCpuList(result["cpus"].as<std::string>(), allowed)) {
+            std::cerr << color.red << "Error: " << color.reset << "Invalid --cpus list: '" << result["cpus"].as<std::string>() << "'\n";
+            return false;
+        }
+        common.topology.restrict(allowed);
+        if (common.topology.cpuCount() == 0) {
+            std::cerr << color.red << "Error: " << color.reset << "None of the CPUs in --cpus are usable\n";
+            return false;
+        }
+    }
+    // A container may see every CPU of the host but only get a share of them
+    std::size_t usableCpus = common.topology.cpuCount();
+    std::size_t quota = cgroupCpuLimit();
+    if (quota != 0 && quota < usableCpus) usableCpus = quota;
+    common.jobs = result["jobs"].as<std::size_t>();
+    if (common.jobs == 0) common.jobs = usableCpus;
+    common.tune = result.count("tune");
+    if (common.tune && common.jobs == 1) {
+        if (result.count("jobs") && result["jobs"].as<std::size_t>() == 1) {
+            std::cerr << color.red << "Warning: " << color.reset << "--tune has nothing to tune with -j 1, ignored\n";
+            common.tune = false;
+        } else {
+            // No -j, or one usable CPU: give the tuner room to climb. Readers
+            // mostly wait on the disk, so even one CPU can keep a few busy.
+            common.jobs = usableCpus < 4 ? 4 : usableCpus;
+        }
+    }
+
+    std::uint64_t budget = 0;
+    if (!parseSize(result["mem-budget"].as<std::string>(), budget) || budget == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "Invalid --mem-budget: '" << result["mem-budget"].as<std::string>() << "'\n";
+        return false;
+    }
+    BufferPool::instance().configure(static_cast<std::size_t>(budget), !result.count("no-huge-pages"));
+
+    common.reflinks = result.count("reflinks");
+    common.rotationalReaders = result["hdd-readers"].as<std::size_t>();
+    common.solidReaders = result["ssd-readers"].as<std::size_t>();
+    // Reading ahead would go around --max-rate, and fill the page cache that
+    // --io direct is meant to leave alone
+    common.prefetch = !result.count("no-prefetch") && !common.throttle && common.read.backend != Backend::Direct;
+
+    if (result.count("idle")) {
+        std::string error;
+        if (!applyIdlePriority(error)) {
+            // Not fatal, the check still works at normal priority
+            std::cerr << color.red << "Warning: " << color.reset << "Could not lower priority: " << error << "\n";
+        }
+    }
+    return true;
+}
+
+bool parseSize(const std::string& text, std::uint64_t& bytes) {
+    std::size_t pos = 0;
+    std::uint64_t value = 0;
+    while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+        std::uint64_t digit = static_cast<std::uint64_t>(text[pos] - '0');
+        // Too large to count in 64 bits: refuse rather than wrap around
+        if (value > (UINT64_MAX - digit) / 10) return false;
+        value = value * 10 + digit;
+        pos++;
+    }
+    if (pos == 0) return false;
+
+    std::string suffix = text.substr(pos);
+    int shift = 0;
+    if (!suffix.empty()) {
+        switch (std::toupper(static_cast<unsigned char>(suffix[0]))) {
+        case 'K': shift = 10; break;
+        case 'M': shift = 20; break;
+        case 'G': shift = 30; break;
+        case 'T': shift = 40; break;
+        default: return false;
+        }
+        // Allow "K", "KB" and "KiB"
+        std::string rest = suffix.substr(1);
+        if (!rest.empty() && rest != "B" && rest != "iB") return false;
+    }
+    if (value > (UINT64_MAX >> shift)) return false;
+    bytes = value << shift;
+    return true;
+}
@@ -0,0 +1,45 @@
+// Options every command understands: how files are read and what gets
+// reported about it
+#pragma once
+
+#include "../lib/cxxopts.hpp"
+#include "reader.h"
+#include "stats.h"
+#include "throttle.h"
+#include "topology.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct CommonOptions {
+    ReadContext read;
+    StatsFormat statsFormat = StatsFormat::None;
+    bool progress = false;
+    // Owned here, pointed to by read.throttle
+    std::unique_ptr<Throttle> throttle;
+    // Worker threads for commands that hash several files at once
+    std::size_t jobs = 1;
+    // Where those workers may run, already narrowed by --cpus
+    CpuTopology topology;
+    // Batches: hash cached files first and read ahead the rest
+    bool prefetch = true;
+    // Batches: files with identical extents count as identical
+    bool reflinks = false;
+    // Batches: reads at a time per spinning disk and per other disk, 0 for
+    // no limit (see iosched.h)
+    std::size_t rotationalReaders = 1;
+    std::size_t solidReaders = 0;
+    // Batches: let a ConcurrencyTuner pick how many workers read at once
+    bool tune = false;
+};
+
+// Parse a byte count with an optional K, M, G or T suffix (powers of 1024).
+// Returns false if the text is not a valid size or does not fit 64 bits.
+bool parseSize(const std::string& text, std::uint64_t& bytes);
+
+void addCommonOptions(cxxopts::Options& options);
+
+// Fill in CommonOptions from a parse result. Prints an error and returns
+// false if a value is not valid.
+bool parseCommonOptions(const cxxopts::ParseResult& result, CommonOptions& common);
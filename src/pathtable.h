@@ -0,0 +1,38 @@
+// Paths of a batch, kept in one string table.
+//
+// A vector of std::string costs a heap block for every path longer than the
+// small string buffer, and a batch of tens of millions of files scatters
+// them all over the heap. Here every path sits back to back, NUL terminated,
+// in one growing buffer and is found through its offset.
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+class PathTable {
+    public:
+    void reserve(std::size_t paths, std::size_t bytes) {
+        offsets.reserve(paths);
+        chars.reserve(bytes);
+    }
+
+    void add(std::string_view path) {
+        offsets.push_back(chars.size());
+        chars.insert(chars.end(), path.begin(), path.end());
+        chars.push_back('\0');
+    }
+
+    std::size_t size() const { return offsets.size(); }
+
+    // NUL terminated for open() and stat(); valid until the next add()
+    const char* c_str(std::size_t path) const { return chars.data() + offsets[path]; }
+    std::string_view operator[](std::size_t path) const {
+        std::size_t end = path + 1 < offsets.size() ? offsets[path + 1] : chars.size();
+        return std::string_view(c_str(path), end - offsets[path] - 1);
+    }
+
+    private:
+    std::vector<char> chars;
+    std::vector<std::size_t> offsets;
+};
@@ -0,0 +1,124 @@
+#include "pool.h"
+
+WorkerPool::WorkerPool(std::size_t workerCount, const CpuTopology& topology, bool pin) {
+    if (workerCount == 0) workerCount = 1;
+    for (std::size_t i = 0; i < workerCount; i++) {
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->index = i;
+    }
+
+    if (workerCount == 1) {
+        // Inline mode: the caller's thread is the worker
+        return;
+    }
+
+    std::vector<int> cpus = pin ? topology.placement(workerCount) : std::vector<int>();
+    for (std::size_t i = 0; i < workerCount; i++) {
+        threads.emplace_back(&WorkerPool::run, this, i, i < cpus.size() ? cpus[i] : -1, std::cref(topology));
+    }
+
+    // Wait until every worker has placed itself
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [&] { return ready == workerCount; });
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) thread.join();
+}
+
+void WorkerPool::run(std::size_t index, int cpu, const CpuTopology& topology) {
+    Worker& self = *workers[index];
+    if (cpu >= 0) {
+        self.cpu = cpu;
+        self.node = topology.nodeOf(cpu);
+        self.pinned = pinCurrentThread(cpu);
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    ready++;
+    finished.notify_all();
+
+    std::size_t seen = generation;
+    for (;;) {
+        wake.wait(guard, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        guard.unlock();
+        drain(self);
+        guard.lock();
+    }
+}
+
+// Take indices until there are none left
+void WorkerPool::drain(Worker& worker) {
+    for (;;) {
+        std::size_t index;
+        const std::function<void(std::size_t, Worker&)>* current;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (task == nullptr || next >= count) return;
+            index = next++;
+            current = task;
+            busy++;
+        }
+        (*current)(index, worker);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            busy--;
+            if (next >= count && busy == 0) finished.notify_all();
+        }
+    }
+}
+
+void WorkerPool::parallelFor(std::size_t taskCount, const std::function<void(std::size_t, Worker&)>& fn) {
+    if (threads.empty()) {
+        for (std::size_t i = 0; i < taskCount; i++) fn(i, *workers[0]);
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    task = &fn;
+    count = taskCount;
+    next = 0;
+    generation++;
+    wake.notify_all();
+    finished.wait(guard, [&] { return next >= count && busy == 0; });
+    task = nullptr;
+}
+
+void WorkerPool::forEachWorker(const std::function<void(Worker&)>& fn) {
+    // Nobody leaves the barrier until every worker holds one index, so no
+    // worker can pick up a second one
+    std::mutex barrierLock;
+    std::condition_variable barrier;
+    std::size_t arrived = 0;
+    const std::size_t total = workers.size();
+
+    parallelFor(total, [&](std::size_t, Worker& worker) {
+        {
+            std::unique_lock<std::mutex> guard(barrierLock);
+            arrived++;
+            barrier.notify_all();
+            barrier.wait(guard, [&] { return arrived == total; });
+        }
+        fn(worker);
+    });
+}
+
+OrderedEmitter::OrderedEmitter(std::size_t count, std::function<void(std::size_t)> emit) :
+    complete(count, false),
+    emit(std::move(emit))
+{}
+
+void OrderedEmitter::done(std::size_t index) {
+    std::lock_guard<std::mutex> guard(lock);
+    complete[index] = true;
+    while (nextToEmit < complete.size() && complete[nextToEmit]) {
+        emit(nextToEmit++);
+    }
+}
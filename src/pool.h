@@ -0,0 +1,83 @@
+// Worker threads for the parallel modes, placed by CPU topology.
+//
+// Each worker pins itself to its CPU before doing anything else. Readers
+// pass the worker's node to the BufferPool, whose slabs are first touched
+// by the thread that needed them, so buffers stay on the worker's node.
+#pragma once
+
+#include "topology.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// What a task knows about the worker running it
+struct Worker {
+    std::size_t index = 0;
+    // Where the topology placed this worker, -1 when unplaced
+    int cpu = -1;
+    int node = -1;
+    // False if the kernel refused the placement (e.g. a simulated topology)
+    bool pinned = false;
+};
+
+class WorkerPool {
+    public:
+    // With one worker no thread is started and tasks run on the caller.
+    // 'pin' false leaves placement to the scheduler.
+    WorkerPool(std::size_t workers, const CpuTopology& topology, bool pin = true);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    std::size_t size() const { return workers.size(); }
+    const Worker& worker(std::size_t index) const { return *workers[index]; }
+
+    // Run task(i, worker) for every i in [0, count) and wait for all of them.
+    // Indices are handed out one at a time, so slow files do not hold up a
+    // whole static share of the work.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t, Worker&)>& task);
+
+    // Run task(worker) exactly once on every worker, e.g. to set up
+    // per-worker state on the worker's own node.
+    void forEachWorker(const std::function<void(Worker&)>& task);
+
+    private:
+    void run(std::size_t index, int cpu, const CpuTopology& topology);
+    void drain(Worker& worker);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(std::size_t, Worker&)>* task = nullptr;
+    std::size_t count = 0;
+    std::size_t next = 0;
+    std::size_t busy = 0;
+    std::size_t generation = 0;
+    std::size_t ready = 0;
+    bool stopping = false;
+};
+
+// Lets tasks complete in any order while their results are written out in
+// index order, as soon as every earlier one is done.
+class OrderedEmitter {
+    public:
+    OrderedEmitter(std::size_t count, std::function<void(std::size_t)> emit);
+
+    // Mark index as complete and emit everything that is now in order
+    void done(std::size_t index);
+
+    private:
+    std::mutex lock;
+    std::vector<bool> complete;
+    std::size_t nextToEmit = 0;
+    std::function<void(std::size_t)> emit;
+};
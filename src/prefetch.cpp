@@ -0,0 +1,124 @@
+#include "prefetch.h"
+
+#include "reader.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Files read ahead per worker
+constexpr std::size_t DepthPerWorker = 2;
+
+// Ask the kernel to start reading the file into the page cache. Linux caps
+// one request at the device's readahead window, which covers small files
+// whole and gets the first extent of big ones moving before the reader
+// takes over with its own sequential readahead.
+void readAhead(const char* path, std::uint64_t size) {
+#ifndef _WIN32
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+#ifdef __linux__
+    ::readahead(fd, 0, static_cast<std::size_t>(size));
+#else
+    posix_fadvise(fd, 0, static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+#endif
+    ::close(fd);
+#else
+    (void)path;
+    (void)size;
+#endif
+}
+
+} // namespace
+
+BatchPlan planBatch(const PathTable& paths, bool probe) {
+    BatchPlan plan;
+    plan.sizes.resize(paths.size(), 0);
+    if (!probe) {
+        for (std::size_t i = 0; i < paths.size(); i++) plan.order.push_back(i);
+        return plan;
+    }
+    std::vector<char> resident(paths.size(), 0);
+
+    for (std::size_t i = 0; i < paths.size(); i++) {
+#ifndef _WIN32
+        int fd = ::open(paths.c_str(i), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            plan.sizes[i] = static_cast<std::uint64_t>(st.st_size);
+            resident[i] = residentShare(fd, plan.sizes[i]) >= io::ResidentShare;
+        }
+        ::close(fd);
+#endif
+    }
+
+    plan.order.reserve(paths.size());
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        if (resident[i]) plan.order.push_back(i);
+    }
+    plan.resident = plan.order.size();
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        if (!resident[i]) plan.order.push_back(i);
+    }
+    return plan;
+}
+
+Prefetcher::Prefetcher(const PathTable& paths, const BatchPlan& plan, std::size_t workers)
+    : paths(paths), plan(plan), depth(DepthPerWorker * workers), next(plan.resident), thread([this] { run(); }) {}
+
+Prefetcher::~Prefetcher() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+void Prefetcher::started(std::size_t position) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (position < reached) return;
+        reached = position + 1;
+    }
+    wake.notify_all();
+}
+
+std::uint64_t Prefetcher::prefetched() {
+    std::lock_guard<std::mutex> guard(lock);
+    return issued;
+}
+
+void Prefetcher::setWorkers(std::size_t workers) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        depth = DepthPerWorker * workers;
+    }
+    wake.notify_all();
+}
+
+void Prefetcher::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        // Files a worker already has are being read anyway
+        if (next < reached) next = reached;
+        wake.wait(guard, [this] {
+            return stopping || (next < plan.order.size() && next < reached + depth);
+        });
+        if (stopping) return;
+        if (next < reached) continue;
+
+        std::size_t index = plan.order[next++];
+        std::uint64_t size = plan.sizes[index];
+        if (size == 0) continue;
+        guard.unlock();
+        readAhead(paths.c_str(index), size);
+        guard.lock();
+        issued++;
+    }
+}
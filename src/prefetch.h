@@ -0,0 +1,68 @@
+// Page cache aware scheduling for commands that hash many files.
+//
+// Before a batch starts, every file is probed with mincore() (see
+// residentShare in reader.h). Files already in the page cache go first:
+// they hash at CPU speed while a Prefetcher thread asks the kernel to read
+// ahead the cold files the workers will reach next. Disk and cores then stay
+// busy together instead of taking turns. Only the processing order changes;
+// commands still print results in input order through an OrderedEmitter.
+#pragma once
+
+#include "pathtable.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct BatchPlan {
+    // Processing order as indices into the batch, resident files first,
+    // each group in input order
+    std::vector<std::size_t> order;
+    // Size of every file by batch index, 0 if it could not be opened
+    std::vector<std::uint64_t> sizes;
+    // The first 'resident' entries of 'order' are in the page cache
+    std::size_t resident = 0;
+};
+
+// Probe every path and order the batch. Without 'probe' nothing is opened:
+// the plan keeps input order and all sizes are 0.
+BatchPlan planBatch(const PathTable& paths, bool probe = true);
+
+class Prefetcher {
+    public:
+    // Read ahead the cold files of the plan, keeping a couple of files per
+    // worker queued in front of the furthest position a worker has started
+    Prefetcher(const PathTable& paths, const BatchPlan& plan, std::size_t workers);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    // A worker picked up plan.order[position]
+    void started(std::size_t position);
+
+    // Files read ahead so far
+    std::uint64_t prefetched();
+
+    // Fewer or more workers are busy now: keep the read-ahead queue in step
+    void setWorkers(std::size_t workers);
+
+    private:
+    void run();
+
+    const PathTable& paths;
+    const BatchPlan& plan;
+    std::size_t depth;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    // Next position to read ahead, and one past the furthest started one
+    std::size_t next;
+    std::size_t reached = 0;
+    std::uint64_t issued = 0;
+    bool stopping = false;
+    std::thread thread;
+};
@@ -0,0 +1,124 @@
+#include "progress.h"
+
+#include "stats.h"
+#include "term.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+// How often the bar is redrawn, and how often a plain line is printed
+constexpr std::chrono::milliseconds TtyInterval(200);
+constexpr std::chrono::milliseconds LogInterval(5000);
+
+std::string humanBytes(double bytes) {
+    static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        unit++;
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), unit == 0 ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+    return buf;
+}
+
+std::string humanDuration(double seconds) {
+    unsigned long total = static_cast<unsigned long>(seconds + 0.5);
+    char buf[32];
+    if (total >= 3600) {
+        std::snprintf(buf, sizeof(buf), "%lu:%02lu:%02lu", total / 3600, (total / 60) % 60, total % 60);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%lu:%02lu", total / 60, total % 60);
+    }
+    return buf;
+}
+
+} // namespace
+
+ProgressReporter::ProgressReporter(const ProgressCounters& counters, std::uint64_t totalBytes, std::uint64_t totalFiles) :
+    counters(counters),
+    totalBytes(totalBytes),
+    totalFiles(totalFiles),
+    tty(IS_TTY(FILENO(stderr))),
+    startNs(nowNs()),
+    thread(&ProgressReporter::run, this)
+{}
+
+ProgressReporter::~ProgressReporter() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void ProgressReporter::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (tty && drawn) {
+        std::fputs("\r\033[K", stderr);
+        std::fflush(stderr);
+        drawn = false;
+    }
+}
+
+void ProgressReporter::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stopping) {
+        if (wake.wait_for(guard, tty ? TtyInterval : LogInterval, [this] { return stopping; })) {
+            break;
+        }
+        draw(false);
+        ticks++;
+    }
+    // Runs that finish before the first tick stay silent
+    if (ticks > 0) draw(true);
+}
+
+// Called with the lock held
+void ProgressReporter::draw(bool final) {
+    std::uint64_t bytes = counters.bytes.load(std::memory_order_relaxed);
+    std::uint64_t files = counters.files.load(std::memory_order_relaxed);
+    double elapsed = static_cast<double>(nowNs() - startNs) / 1e9;
+    double rate = elapsed > 0 ? static_cast<double>(bytes) / elapsed : 0.0;
+
+    std::string line;
+    if (totalBytes > 0) {
+        double fraction = static_cast<double>(bytes) / static_cast<double>(totalBytes);
+        if (fraction > 1.0) fraction = 1.0;
+        if (tty) {
+            constexpr int width = 30;
+            int filled = static_cast<int>(fraction * width);
+            line += '[' + std::string(filled, '#') + std::string(width - filled, '.') + "] ";
+        }
+        char percent[16];
+        std::snprintf(percent, sizeof(percent), "%3.0f%% ", fraction * 100.0);
+        line += percent;
+        line += humanBytes(static_cast<double>(bytes)) + " / " + humanBytes(static_cast<double>(totalBytes));
+    } else {
+        line += humanBytes(static_cast<double>(bytes));
+    }
+    line += "  " + humanBytes(rate) + "/s";
+
+    if (totalFiles > 1) {
+        line += "  files " + std::to_string(files) + "/" + std::to_string(totalFiles);
+        line += " (" + std::to_string(totalFiles > files ? totalFiles - files : 0) + " left)";
+    }
+    if (!final && totalBytes > bytes && rate > 0) {
+        line += "  ETA " + humanDuration(static_cast<double>(totalBytes - bytes) / rate);
+    }
+    if (final) {
+        line += "  in " + humanDuration(elapsed);
+    }
+
+    if (tty) {
+        std::fprintf(stderr, final ? "\r\033[K%s\n" : "\r\033[K%s", line.c_str());
+    } else {
+        std::fprintf(stderr, "itfl: progress %s\n", line.c_str());
+    }
+    std::fflush(stderr);
+    drawn = !final;
+}
@@ -0,0 +1,49 @@
+// Live progress on stderr, drawn by its own thread.
+//
+// The read loop only bumps an atomic byte counter with a relaxed add per
+// buffer (see io::feed); everything else, including the clock, happens on
+// the reporter thread. On a TTY it redraws a bar a few times a second,
+// otherwise it prints a plain line every few seconds so logs stay readable.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+struct ProgressCounters {
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> files{0};
+};
+
+class ProgressReporter {
+    public:
+    // Totals are what the run expects to process; 0 means unknown
+    ProgressReporter(const ProgressCounters& counters, std::uint64_t totalBytes, std::uint64_t totalFiles);
+    ~ProgressReporter();
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+    // Erase the bar so the caller can print a line of its own.
+    // The next tick draws it again below.
+    void clear();
+
+    private:
+    void run();
+    void draw(bool final);
+
+    const ProgressCounters& counters;
+    const std::uint64_t totalBytes;
+    const std::uint64_t totalFiles;
+    const bool tty;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool drawn = false;
+    unsigned long ticks = 0;
+    std::uint64_t startNs;
+    std::thread thread;
+};
@@ -0,0 +1,9 @@
+// One raw SHA-256 digest as a value: comparable, usable as a map key and
+// cheap to copy, for code that groups or looks up files by content.
+#pragma once
+
+#include "../lib/sha256.h"
+
+#include <array>
+
+typedef std::array<unsigned char, SHA256::HashBytes> RawDigest;
@@ -0,0 +1,267 @@
+#include "reader.h"
+
+#include "device.h"
+
+#include <filesystem>
+#include <mutex>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/vfs.h>
+#endif
+
+namespace {
+
+// Unallocated bytes a file needs before holes are worth seeking for
+constexpr std::uint64_t SparseMinHole = io::BufferSize;
+// Cold files from this size on are worth keeping out of the page cache
+constexpr std::uint64_t DirectMinSize = std::uint64_t(64) << 20;
+// Pages probed with mincore() on big files
+constexpr std::size_t ResidencySamples = 1024;
+
+#ifdef __linux__
+// From linux/magic.h
+enum : unsigned long {
+    NfsMagic = 0x6969,
+    SmbMagic = 0x517B,
+    Smb2Magic = 0xFE534D42,
+    CifsMagic = 0xFF534D42,
+    FuseMagic = 0x65735546,
+    TmpfsMagic = 0x01021994,
+    RamfsMagic = 0x858458F6,
+    ProcMagic = 0x9FA0,
+    SysfsMagic = 0x62656572,
+};
+#endif
+
+enum class FsKind { Local, Memory, Network, Pseudo };
+
+FsKind filesystemKind(int fd) {
+#ifdef __linux__
+    struct statfs fs;
+    if (fstatfs(fd, &fs) != 0) return FsKind::Local;
+    switch (static_cast<unsigned long>(fs.f_type) & 0xFFFFFFFFul) {
+    case TmpfsMagic:
+    case RamfsMagic:
+        return FsKind::Memory;
+    case NfsMagic:
+    case SmbMagic:
+    case Smb2Magic:
+    case CifsMagic:
+    case FuseMagic:
+        return FsKind::Network;
+    case ProcMagic:
+    case SysfsMagic:
+        return FsKind::Pseudo;
+    }
+#else
+    (void)fd;
+#endif
+    return FsKind::Local;
+}
+
+} // namespace
+
+namespace io {
+
+alignas(4096) char ZeroBuffer[BufferSize];
+
+char* smallFileBuffer() {
+    alignas(64) static thread_local char buffer[SmallFileSize];
+    return buffer;
+}
+
+#ifndef _WIN32
+namespace {
+
+// The mapping the calling thread is hashing, and where to go if it faults
+thread_local sigjmp_buf* faultJump = nullptr;
+thread_local const char* faultBegin = nullptr;
+thread_local const char* faultEnd = nullptr;
+struct sigaction previousBus;
+
+void onBus(int signal, siginfo_t* info, void* context) {
+    const char* address = static_cast<const char*>(info->si_addr);
+    if (faultJump && address >= faultBegin && address < faultEnd) siglongjmp(*faultJump, 1);
+    // Not a page of a guarded mapping: whatever was there before us decides,
+    // by default the fault repeats and kills the process
+    if (previousBus.sa_flags & SA_SIGINFO) {
+        previousBus.sa_sigaction(signal, info, context);
+    } else if (previousBus.sa_handler != SIG_IGN && previousBus.sa_handler != SIG_DFL) {
+        previousBus.sa_handler(signal);
+    } else {
+        sigaction(SIGBUS, &previousBus, nullptr);
+    }
+}
+
+} // namespace
+
+MappedFaultGuard::MappedFaultGuard(sigjmp_buf& jump, const void* data, std::size_t size) {
+    static std::once_flag installed;
+    std::call_once(installed, [] {
+        struct sigaction action = {};
+        action.sa_sigaction = onBus;
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, &previousBus);
+    });
+    faultBegin = static_cast<const char*>(data);
+    faultEnd = faultBegin + size;
+    faultJump = &jump;
+}
+
+MappedFaultGuard::~MappedFaultGuard() {
+    faultJump = nullptr;
+    faultBegin = faultEnd = nullptr;
+}
+#endif
+
+} // namespace io
+
+#ifndef _WIN32
+double residentShare(int fd, std::uint64_t size) {
+    if (size == 0) return 1.0;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return 0.0;
+
+    std::size_t pages = (size + pageSize - 1) / pageSize;
+    std::size_t step = pages > ResidencySamples ? pages / ResidencySamples : 1;
+    std::size_t resident = 0, probed = 0;
+    unsigned char vec[1];
+    for (std::size_t page = 0; page < pages; page += step) {
+        if (mincore(static_cast<char*>(map) + page * pageSize, 1, vec) == 0) {
+            resident += vec[0] & 1;
+        }
+        probed++;
+    }
+    munmap(map, size);
+    return probed == 0 ? 0.0 : static_cast<double>(resident) / static_cast<double>(probed);
+}
+#endif
+
+const char* backendName(Backend backend) {
+    switch (backend) {
+    case Backend::Stream: return "stream";
+    case Backend::Read: return "read";
+    case Backend::Pread: return "pread";
+    case Backend::Mmap: return "mmap";
+    case Backend::Direct: return "direct";
+    case Backend::Sparse: return "sparse";
+    case Backend::Pipelined: return "pipelined";
+    case Backend::Auto: return "auto";
+    }
+    return "unknown";
+}
+
+bool parseBackend(const std::string& name, Backend& backend) {
+    for (std::size_t i = 0; i < BackendCount; i++) {
+        if (name == backendName(static_cast<Backend>(i))) {
+            backend = static_cast<Backend>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::uint64_t fileSize(const std::string& filename) {
+    std::error_code error;
+    std::uintmax_t size = std::filesystem::file_size(filename, error);
+    if (!error) return static_cast<std::uint64_t>(size);
+#ifndef _WIN32
+    // Devices have no file size, ask the device
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    struct stat st;
+    std::uint64_t deviceSize = 0;
+    bool known = fstat(fd, &st) == 0 && objectSize(fd, st, deviceSize);
+    ::close(fd);
+    if (known) return deviceSize;
+#endif
+    return 0;
+}
+
+bool fileStat(const std::string& filename, std::uint64_t& size, std::int64_t& mtimeNs) {
+#ifndef _WIN32
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return false;
+#ifdef __APPLE__
+    const struct timespec& mtime = st.st_mtimespec;
+#else
+    const struct timespec& mtime = st.st_mtim;
+#endif
+    size = static_cast<std::uint64_t>(st.st_size);
+    mtimeNs = static_cast<std::int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+    return true;
+#else
+    std::error_code error;
+    size = std::filesystem::file_size(filename, error);
+    if (error) return false;
+    auto mtime = std::filesystem::last_write_time(filename, error);
+    if (error) return false;
+    mtimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+    return true;
+#endif
+}
+
+#ifndef _WIN32
+bool objectSize(int fd, const struct stat& st, std::uint64_t& size) {
+    if (S_ISREG(st.st_mode)) {
+        size = static_cast<std::uint64_t>(st.st_size);
+        return true;
+    }
+#ifdef BLKGETSIZE64
+    if (S_ISBLK(st.st_mode)) {
+        std::uint64_t bytes = 0;
+        if (ioctl(fd, BLKGETSIZE64, &bytes) != 0) return false;
+        size = bytes;
+        return true;
+    }
+#endif
+    return false;
+}
+#endif
+
+#ifndef _WIN32
+Backend chooseBackend(int fd, const struct stat& st) {
+    if (!S_ISREG(st.st_mode)) return Backend::Read;
+
+    FsKind kind = filesystemKind(fd);
+    // Sizes on pseudo filesystems are made up, and a mapping over the
+    // network turns server hiccups into SIGBUS
+    if (kind == FsKind::Pseudo || kind == FsKind::Network) return Backend::Read;
+
+    std::uint64_t size = static_cast<std::uint64_t>(st.st_size);
+    if (size <= io::SmallFileSize) return Backend::Pread;
+#ifdef SEEK_HOLE
+    // Fewer blocks allocated than the size needs: thin images and the like.
+    // Compressed files on btrfs or ZFS look the same, so only an actual hole
+    // before the end counts. SEEK_HOLE moves the offset, put it back.
+    std::uint64_t allocated = static_cast<std::uint64_t>(st.st_blocks) * 512;
+    if (allocated + SparseMinHole <= size) {
+        off_t hole = ::lseek(fd, 0, SEEK_HOLE);
+        ::lseek(fd, 0, SEEK_SET);
+        if (hole >= 0 && static_cast<std::uint64_t>(hole) < size) return Backend::Sparse;
+    }
+#endif
+    if (kind == FsKind::Memory) return Backend::Mmap;
+    if (residentShare(fd, size) >= io::ResidentShare) return Backend::Mmap;
+
+#ifdef O_DIRECT
+    // Spinning disks rely on kernel readahead to keep streaming, so only
+    // bypass the cache on solid state devices
+    if (size >= DirectMinSize) {
+        DeviceInfo device = describeDevice(st.st_dev);
+        if (device.known && !device.rotational) return Backend::Direct;
+    }
+#endif
+    // Big and cold anywhere else: read the next block while this one hashes
+    if (size >= DirectMinSize) return Backend::Pipelined;
+    return Backend::Read;
+}
+#endif
@@ -0,0 +1,558 @@
+// I/O backends. Every backend is a template over the sink it feeds, which
+// is a Hasher or a HasherSet (see hasher.h): anything with
+// add(const void*, size_t).
+#pragma once
+
+#include "backend.h"
+#include "bufpool.h"
+#include "stats.h"
+#include "throttle.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <setjmp.h>
+#endif
+
+class WorkerPool;
+
+// Length of a range that runs to the end of the file
+constexpr std::uint64_t WholeFile = ~std::uint64_t(0);
+
+// Size of a file or block device in bytes, 0 if it cannot be determined
+std::uint64_t fileSize(const std::string& filename);
+
+// Size and modification time (nanoseconds since the epoch), what manifests
+// record to tell later whether a file may have changed. Returns false if
+// the file cannot be stat'ed.
+bool fileStat(const std::string& filename, std::uint64_t& size, std::int64_t& mtimeNs);
+
+// How a file gets read, shared by every command
+struct ReadContext {
+    Backend backend = Backend::Auto;
+    // Byte range to hash, the whole file by default. Ranges are always read
+    // with pread(), whatever the backend.
+    std::uint64_t offset = 0;
+    std::uint64_t length = WholeFile;
+    // Workers a single file may be split across (tree digests), when set
+    WorkerPool* pool = nullptr;
+    // Per-phase timings, only collected when set
+    IoStats* stats = nullptr;
+    // Bytes hashed so far, sampled by a ProgressReporter when set
+    std::atomic<std::uint64_t>* progress = nullptr;
+    // Bandwidth cap, applied between reads when set
+    Throttle* throttle = nullptr;
+    // NUMA node of the calling thread, so buffers come from local memory
+    int node = -1;
+
+    bool ranged() const { return offset != 0 || length != WholeFile; }
+};
+
+// Turn the context's range into an absolute one for an object of 'size'
+// bytes. Returns false if the range does not fit inside it.
+inline bool resolveRange(const ReadContext& ctx, std::uint64_t size, std::uint64_t& offset, std::uint64_t& length) {
+    if (ctx.offset > size) return false;
+    offset = ctx.offset;
+    length = ctx.length == WholeFile ? size - offset : ctx.length;
+    return length <= size - offset;
+}
+
+namespace io {
+
+// Files up to this size are read with one pread()
+constexpr std::uint64_t SmallFileSize = 64 * 1024;
+// Share of pages that must be cached for a file to count as resident
+constexpr double ResidentShare = 0.9;
+
+// Zeros that stand in for holes in sparse files. Never written, so it lives
+// in .bss and every page of it maps the kernel's shared zero page.
+extern char ZeroBuffer[BufferSize];
+
+// SmallFileSize bytes owned by the calling thread, for readSmall()
+char* smallFileBuffer();
+
+// Hand one buffer to the sink, timing it when stats are on
+template <typename Sink>
+inline void feed(Sink& sink, const char* data, std::size_t size, const ReadContext& ctx) {
+    IoStats* stats = ctx.stats;
+    if (ctx.progress) {
+        ctx.progress->fetch_add(size, std::memory_order_relaxed);
+    }
+    if (stats) {
+        std::uint64_t start = nowNs();
+        sink.add(data, size);
+        stats->hashNs += nowNs() - start;
+        stats->bytes += size;
+    } else {
+        sink.add(data, size);
+    }
+}
+
+// Debit a read against the bandwidth cap, if there is one, and count the
+// bytes it returned: from read() or pread(), or 'mapped' from a mapping
+inline void pace(const ReadContext& ctx, std::size_t size, bool mapped = false) {
+    if (ctx.stats) (mapped ? ctx.stats->mappedBytes : ctx.stats->readBytes) += size;
+    if (ctx.throttle) {
+        std::uint64_t slept = ctx.throttle->consume(size);
+        if (ctx.stats) ctx.stats->throttleNs += slept;
+    }
+}
+
+// Read full buffers until eofbit and failbit are set by file_stream.read()
+// eofbit set when end of file is hit
+// This also triggers failbit because full read request was not completed
+// This will make the while loop evaluate to false
+// Returns false on a read error (badbit), true otherwise.
+template <typename Sink>
+bool readStream(std::istream& file_stream, Sink& sink, const ReadContext& ctx) {
+    IoStats* stats = ctx.stats;
+    BufferPool::Lease lease = BufferPool::instance().acquire(ctx.node);
+    char* buf = lease.data();
+
+    std::streamsize bytesRead;
+    for (;;) {
+        std::uint64_t start = stats ? nowNs() : 0;
+        bool full = static_cast<bool>(file_stream.read(buf, BufferSize));
+        if (stats) {
+            stats->readNs += nowNs() - start;
+            stats->readCalls++;
+        }
+        bytesRead = file_stream.gcount();
+        pace(ctx, static_cast<std::size_t>(bytesRead));
+        if (!full) break;
+        feed(sink, buf, static_cast<std::size_t>(bytesRead), ctx);
+    }
+
+    // See if there were more than 0 bytes read at the end, when there's not a full buffer left
+    // If so, process those bytes too
+    bytesRead = file_stream.gcount();
+    if (bytesRead > 0) {
+        feed(sink, buf, static_cast<std::size_t>(bytesRead), ctx);
+    }
+    return !file_stream.bad();
+}
+
+#ifndef _WIN32
+// Plain read() loop on an open descriptor, until EOF
+template <typename Sink>
+bool readFd(int fd, Sink& sink, const ReadContext& ctx) {
+    IoStats* stats = ctx.stats;
+    BufferPool::Lease lease = BufferPool::instance().acquire(ctx.node);
+    char* buf = lease.data();
+    for (;;) {
+        std::uint64_t start = stats ? nowNs() : 0;
+        ssize_t bytesRead = ::read(fd, buf, BufferSize);
+        if (stats) {
+            stats->readNs += nowNs() - start;
+            stats->readCalls++;
+        }
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (bytesRead == 0) return true;
+        pace(ctx, static_cast<std::size_t>(bytesRead));
+        feed(sink, buf, static_cast<std::size_t>(bytesRead), ctx);
+    }
+}
+
+// pread() exactly 'length' bytes from 'start'. Works on anything that can
+// seek, block devices included. If the file shrank meanwhile, stops at the
+// new end.
+template <typename Sink>
+bool readRange(int fd, std::uint64_t start, std::uint64_t length, Sink& sink, const ReadContext& ctx) {
+    IoStats* stats = ctx.stats;
+    BufferPool::Lease lease = BufferPool::instance().acquire(ctx.node);
+    char* buf = lease.data();
+    std::uint64_t offset = start;
+    const std::uint64_t end = start + length;
+    while (offset < end) {
+        std::size_t want = end - offset < BufferSize ? static_cast<std::size_t>(end - offset) : BufferSize;
+        std::uint64_t t0 = stats ? nowNs() : 0;
+        ssize_t bytesRead = ::pread(fd, buf, want, static_cast<off_t>(offset));
+        if (stats) {
+            stats->readNs += nowNs() - t0;
+            stats->readCalls++;
+        }
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (bytesRead == 0) break;
+        pace(ctx, static_cast<std::size_t>(bytesRead));
+        feed(sink, buf, static_cast<std::size_t>(bytesRead), ctx);
+        offset += static_cast<std::uint64_t>(bytesRead);
+    }
+    return true;
+}
+
+// pread() exactly 'size' bytes, the length fstat reported. Saves the extra
+// read() that only returns EOF, which matters for small files.
+template <typename Sink>
+bool readPread(int fd, std::uint64_t size, Sink& sink, const ReadContext& ctx) {
+    return readRange(fd, 0, size, sink, ctx);
+}
+
+// The fast path for files of at most SmallFileSize bytes: one pread() of
+// the size fstat reported into a buffer the thread keeps, and one add() of
+// the whole file. No pool buffer is leased and no backend is chosen.
+template <typename Sink>
+bool readSmall(int fd, std::size_t size, Sink& sink, const ReadContext& ctx) {
+    IoStats* stats = ctx.stats;
+    char* buf = smallFileBuffer();
+    std::size_t got = 0;
+    // More than one call only if the file shrank or a signal came in
+    while (got < size) {
+        std::uint64_t start = stats ? nowNs() : 0;
+        ssize_t bytesRead = ::pread(fd, buf + got, size - got, static_cast<off_t>(got));
+        if (stats) {
+            stats->readNs += nowNs() - start;
+            stats->readCalls++;
+        }
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (bytesRead == 0) break;
+        got += static_cast<std::size_t>(bytesRead);
+    }
+    pace(ctx, got);
+    feed(sink, buf, got, ctx);
+    return true;
+}
+
+#ifdef O_DIRECT
+// read() with O_DIRECT: the data goes straight from the device into the
+// pool buffer (page aligned, BufferSize a multiple of any block size) and
+// never fills the page cache. Filesystems that refuse O_DIRECT get the
+// plain read() loop instead.
+template <typename Sink>
+bool readDirect(int fd, Sink& sink, const ReadContext& ctx) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_DIRECT) != 0) {
+        return readFd(fd, sink, ctx);
+    }
+
+    IoStats* stats = ctx.stats;
+    BufferPool::Lease lease = BufferPool::instance().acquire(ctx.node);
+    char* buf = lease.data();
+    bool first = true;
+    for (;;) {
+        std::uint64_t start = stats ? nowNs() : 0;
+        ssize_t bytesRead = ::read(fd, buf, BufferSize);
+        if (stats) {
+            stats->readNs += nowNs() - start;
+            stats->readCalls++;
+        }
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL && first) {
+                fcntl(fd, F_SETFL, flags);
+                if (stats) {
+                    stats->backendFiles[static_cast<std::size_t>(Backend::Direct)]--;
+                    stats->backendFiles[static_cast<std::size_t>(Backend::Read)]++;
+                }
+                lease = BufferPool::Lease();
+                return readFd(fd, sink, ctx);
+            }
+            return false;
+        }
+        first = false;
+        if (bytesRead == 0) return true;
+        pace(ctx, static_cast<std::size_t>(bytesRead));
+        feed(sink, buf, static_cast<std::size_t>(bytesRead), ctx);
+    }
+}
+#endif
+
+#ifdef SEEK_HOLE
+// Hash 'length' bytes of a hole: zeros from ZeroBuffer, no I/O and no pacing
+template <typename Sink>
+void feedHole(Sink& sink, std::uint64_t length, const ReadContext& ctx) {
+    if (ctx.stats) ctx.stats->holeBytes += length;
+    while (length > 0) {
+        std::size_t chunk = length < BufferSize ? static_cast<std::size_t>(length) : BufferSize;
+        feed(sink, ZeroBuffer, chunk, ctx);
+        length -= chunk;
+    }
+}
+
+// Walk the file with SEEK_DATA/SEEK_HOLE up to 'size', the length fstat
+// reported: data extents are read with pread(), holes are hashed as zeros
+// without touching the disk. The digest is the same as for the dense file.
+// Filesystems without hole support report one extent covering the whole
+// file, which makes this a plain pread loop.
+template <typename Sink>
+bool readSparse(int fd, std::uint64_t size, Sink& sink, const ReadContext& ctx) {
+    IoStats* stats = ctx.stats;
+    BufferPool::Lease lease = BufferPool::instance().acquire(ctx.node);
+    char* buf = lease.data();
+    std::uint64_t offset = 0;
+    while (offset < size) {
+        off_t data = lseek(fd, static_cast<off_t>(offset), SEEK_DATA);
+        std::uint64_t dataStart = size;
+        if (data >= 0) {
+            dataStart = static_cast<std::uint64_t>(data) < size ? static_cast<std::uint64_t>(data) : size;
+        } else if (errno != ENXIO) {
+            // ENXIO means nothing but a hole up to the end
+            return false;
+        }
+        feedHole(sink, dataStart - offset, ctx);
+        offset = dataStart;
+        if (offset >= size) break;
+
+        off_t hole = lseek(fd, static_cast<off_t>(offset), SEEK_HOLE);
+        std::uint64_t dataEnd = size;
+        if (hole >= 0 && static_cast<std::uint64_t>(hole) < size) dataEnd = static_cast<std::uint64_t>(hole);
+        while (offset < dataEnd) {
+            std::size_t want = dataEnd - offset < BufferSize ? static_cast<std::size_t>(dataEnd - offset) : BufferSize;
+            std::uint64_t start = stats ? nowNs() : 0;
+            ssize_t bytesRead = ::pread(fd, buf, want, static_cast<off_t>(offset));
+            if (stats) {
+                stats->readNs += nowNs() - start;
+                stats->readCalls++;
+            }
+            if (bytesRead < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            // Shrunk meanwhile, stop at the new end like readPread()
+            if (bytesRead == 0) return true;
+            pace(ctx, static_cast<std::size_t>(bytesRead));
+            feed(sink, buf, static_cast<std::size_t>(bytesRead), ctx);
+            offset += static_cast<std::uint64_t>(bytesRead);
+        }
+    }
+    return true;
+}
+#endif
+
+// read() on a helper thread into one half of a pool buffer while the caller
+// hashes the other half, so the disk and the CPU work at the same time
+// instead of taking turns. Both halves come from one lease, so a worker
+// never waits on the pool for a second buffer. A thread per file only pays
+// off for big files that still have to come from disk.
+template <typename Sink>
+bool readPipelined(int fd, Sink& sink, const ReadContext& ctx) {
+    constexpr std::size_t HalfSize = BufferSize / 2;
+    BufferPool::Lease lease = BufferPool::instance().acquire(ctx.node);
+    char* halves[2] = {lease.data(), lease.data() + HalfSize};
+    // Bytes waiting in each half, 0 while the reader owns it
+    std::size_t filled[2] = {0, 0};
+    bool finished = false, failed = false;
+    std::mutex lock;
+    std::condition_variable changed;
+    // The reader's own counters, added to the stats once it is done
+    std::uint64_t readNs = 0, readCalls = 0;
+
+    std::thread reader([&] {
+        for (std::size_t i = 0;; i ^= 1) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&] { return filled[i] == 0; });
+            }
+            ssize_t bytesRead;
+            do {
+                std::uint64_t start = ctx.stats ? nowNs() : 0;
+                bytesRead = ::read(fd, halves[i], HalfSize);
+                if (ctx.stats) {
+                    readNs += nowNs() - start;
+                    readCalls++;
+                }
+            } while (bytesRead < 0 && errno == EINTR);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (bytesRead > 0) {
+                    filled[i] = static_cast<std::size_t>(bytesRead);
+                } else {
+                    finished = true;
+                    failed = bytesRead < 0;
+                }
+            }
+            changed.notify_all();
+            if (bytesRead <= 0) return;
+        }
+    });
+
+    // Halves come back in the order they were read; after the reader is
+    // done, only what it filled before is left
+    for (std::size_t i = 0;; i ^= 1) {
+        std::size_t size;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&] { return filled[i] != 0 || finished; });
+            size = filled[i];
+        }
+        if (size == 0) break;
+        pace(ctx, size);
+        feed(sink, halves[i], size, ctx);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            filled[i] = 0;
+        }
+        changed.notify_all();
+    }
+    reader.join();
+    if (ctx.stats) {
+        ctx.stats->readNs += readNs;
+        ctx.stats->readCalls += readCalls;
+    }
+    return !failed;
+}
+
+// While alive, a SIGBUS on this thread from touching [data, data + size)
+// jumps back to 'jump' instead of killing the process. A mapped file that
+// is truncated while it is hashed faults on the pages past its new end;
+// logs and editors that rewrite with O_TRUNC do that all the time.
+class MappedFaultGuard {
+    public:
+    MappedFaultGuard(sigjmp_buf& jump, const void* data, std::size_t size);
+    ~MappedFaultGuard();
+
+    MappedFaultGuard(const MappedFaultGuard&) = delete;
+    MappedFaultGuard& operator=(const MappedFaultGuard&) = delete;
+};
+
+// Map the file and feed it in BufferSize slices. Only regular files can be
+// mapped; anything else falls back to readFd(). Page faults happen inside
+// the sink, so with stats on they are counted as hashing time. A file that
+// shrinks underneath fails the read and counts as changed in the stats.
+template <typename Sink>
+bool readMmap(int fd, Sink& sink, const ReadContext& ctx) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    // Pseudo files claim to be empty, so let read() find out
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) return readFd(fd, sink, ctx);
+
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return readFd(fd, sink, ctx);
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const char* data = static_cast<const char*>(map);
+    sigjmp_buf jump;
+    MappedFaultGuard guard(jump, data, size);
+    if (sigsetjmp(jump, 1) != 0) {
+        // Only plain data lives between here and the fault: nothing to unwind
+        munmap(map, size);
+        if (ctx.stats) ctx.stats->changedFiles++;
+        return false;
+    }
+    for (std::size_t offset = 0; offset < size; offset += BufferSize) {
+        std::size_t chunk = size - offset < BufferSize ? size - offset : BufferSize;
+        pace(ctx, chunk, true);
+        feed(sink, data + offset, chunk, ctx);
+    }
+    munmap(map, size);
+    return true;
+}
+#endif
+
+} // namespace io
+
+#ifndef _WIN32
+// Size of a regular file, or of a block device (BLKGETSIZE64). Returns
+// false for anything else, e.g. pipes.
+bool objectSize(int fd, const struct stat& st, std::uint64_t& size);
+
+// Share of the file's pages in the page cache, from mincore() on a probe
+// mapping (sampled on big files). Mapping without touching costs no I/O.
+double residentShare(int fd, std::uint64_t size);
+
+// Backend for one file under --io auto. Small files get a single pread,
+// files with large holes skip them, files already in the page cache get mapped, big cold files on SSDs get
+// O_DIRECT so they do not evict everything else, other big cold files are
+// read ahead on a helper thread, and the rest, including network and
+// pseudo filesystems, get the plain read() loop.
+Backend chooseBackend(int fd, const struct stat& st);
+
+// Read an open descriptor with a concrete (not Auto or Stream) backend
+template <typename Sink>
+bool readWith(Backend backend, int fd, const struct stat& st, Sink& sink, const ReadContext& ctx) {
+    if (ctx.stats) ctx.stats->backendFiles[static_cast<std::size_t>(backend)]++;
+    switch (backend) {
+    case Backend::Pread:
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            return io::readPread(fd, static_cast<std::uint64_t>(st.st_size), sink, ctx);
+        }
+        return io::readFd(fd, sink, ctx);
+    case Backend::Mmap:
+        return io::readMmap(fd, sink, ctx);
+    case Backend::Pipelined:
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return io::readPipelined(fd, sink, ctx);
+#ifdef O_DIRECT
+    case Backend::Direct:
+        return io::readDirect(fd, sink, ctx);
+#endif
+#ifdef SEEK_HOLE
+    case Backend::Sparse:
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            return io::readSparse(fd, static_cast<std::uint64_t>(st.st_size), sink, ctx);
+        }
+        return io::readFd(fd, sink, ctx);
+#endif
+    default:
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return io::readFd(fd, sink, ctx);
+    }
+}
+#endif
+
+// Open a file and feed all of it to the sink through the chosen backend.
+// Returns false if the file could not be opened or read.
+template <typename Sink>
+bool hashFile(const std::string& filename, const ReadContext& ctx, Sink& sink) {
+    IoStats* stats = ctx.stats;
+    std::uint64_t start = stats ? nowNs() : 0;
+    if (stats) stats->files++;
+
+#ifndef _WIN32
+    if (ctx.backend != Backend::Stream) {
+        int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        bool opened = fd >= 0 && fstat(fd, &st) == 0;
+        if (stats) stats->openNs += nowNs() - start;
+        if (!opened) {
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+        bool ok;
+        if (ctx.ranged()) {
+            std::uint64_t size = 0, offset = 0, length = 0;
+            if (stats) stats->backendFiles[static_cast<std::size_t>(Backend::Pread)]++;
+            ok = objectSize(fd, st, size) && resolveRange(ctx, size, offset, length) &&
+                 io::readRange(fd, offset, length, sink, ctx);
+        } else if (ctx.backend == Backend::Auto && S_ISREG(st.st_mode) && st.st_size > 0 &&
+                   static_cast<std::uint64_t>(st.st_size) <= io::SmallFileSize) {
+            // Most files of a big batch: not worth a backend decision
+            if (stats) stats->backendFiles[static_cast<std::size_t>(Backend::Pread)]++;
+            ok = io::readSmall(fd, static_cast<std::size_t>(st.st_size), sink, ctx);
+        } else {
+            Backend backend = ctx.backend == Backend::Auto ? chooseBackend(fd, st) : ctx.backend;
+            ok = readWith(backend, fd, st, sink, ctx);
+        }
+        ::close(fd);
+        return ok;
+    }
+    // Ranges need pread(); the command line refuses them with --io stream
+    if (ctx.ranged()) return false;
+#endif
+    if (stats) stats->backendFiles[static_cast<std::size_t>(Backend::Stream)]++;
+    std::ifstream file_stream(filename, std::ios::binary);
+    if (stats) stats->openNs += nowNs() - start;
+    if (!file_stream) return false;
+    return io::readStream(file_stream, sink, ctx);
+}
@@ -0,0 +1,115 @@
+#include "results.h"
+
+#include "hex.h"
+
+#include <cstring>
+
+BatchResults::BatchResults(std::size_t count, bool withCrc32c, bool withStat) : count(count) {
+    constexpr std::size_t DigestBytes = sizeof(RawFileDigests::sha256);
+    constexpr std::size_t CrcBytes = sizeof(RawFileDigests::crc32c);
+    // Widest fields first, so every array stays aligned
+    const std::size_t statBytes = withStat ? count * (sizeof(std::uint64_t) + sizeof(std::int64_t)) : 0;
+    const std::size_t total = statBytes + count * (DigestBytes + (withCrc32c ? CrcBytes : 0) + 1);
+    arena.reset(new unsigned char[total == 0 ? 1 : total]);
+
+    unsigned char* next = arena.get();
+    if (withStat) {
+        sizes = reinterpret_cast<std::uint64_t*>(next);
+        next += count * sizeof(std::uint64_t);
+        mtimes = reinterpret_cast<std::int64_t*>(next);
+        next += count * sizeof(std::int64_t);
+    }
+    sha256 = next;
+    next += count * DigestBytes;
+    if (withCrc32c) {
+        crc32c = next;
+        next += count * CrcBytes;
+    }
+    flags = next;
+    std::memset(flags, 0, count);
+}
+
+void BatchResults::setDigests(std::size_t file, const RawFileDigests& digests) {
+    std::memcpy(sha256 + file * sizeof(digests.sha256), digests.sha256, sizeof(digests.sha256));
+    if (crc32c) std::memcpy(crc32c + file * sizeof(digests.crc32c), digests.crc32c, sizeof(digests.crc32c));
+    flags[file] |= Hashed;
+}
+
+void BatchResults::setStat(std::size_t file, std::uint64_t size, std::int64_t mtimeNs) {
+    if (!sizes) return;
+    sizes[file] = size;
+    mtimes[file] = mtimeNs;
+    flags[file] |= HasStat;
+}
+
+void BatchResults::copyDigests(std::size_t from, std::size_t to) {
+    constexpr std::size_t DigestBytes = sizeof(RawFileDigests::sha256);
+    constexpr std::size_t CrcBytes = sizeof(RawFileDigests::crc32c);
+    std::memcpy(sha256 + to * DigestBytes, sha256 + from * DigestBytes, DigestBytes);
+    if (crc32c) std::memcpy(crc32c + to * CrcBytes, crc32c + from * CrcBytes, CrcBytes);
+    flags[to] = static_cast<std::uint8_t>((flags[to] & ~Hashed) | (flags[from] & Hashed));
+}
+
+RawManifestEntry BatchResults::entry(std::size_t file, std::string_view path) const {
+    RawManifestEntry entry;
+    entry.path = path;
+    entry.sha256 = sha256 + file * sizeof(RawFileDigests::sha256);
+    if (crc32c) entry.crc32c = crc32c + file * sizeof(RawFileDigests::crc32c);
+    if (flags[file] & HasStat) {
+        entry.hasStat = true;
+        entry.size = sizes[file];
+        entry.mtimeNs = mtimes[file];
+    }
+    return entry;
+}
+
+void ExpectedDigests::reserve(std::size_t entries, std::size_t pathBytes) {
+    keyBytes.reserve(entries * KeyBytes);
+    sizes.reserve(entries);
+    pathTable.reserve(entries, pathBytes);
+}
+
+void ExpectedDigests::add(const ManifestEntry& entry) {
+    RawFileDigests digests;
+    RawManifestEntry raw;
+    if (fromHex(entry.sha256, digests.sha256, sizeof(digests.sha256))) raw.sha256 = digests.sha256;
+    if (fromHex(entry.crc32c, digests.crc32c, sizeof(digests.crc32c))) raw.crc32c = digests.crc32c;
+    raw.path = entry.path;
+    raw.hasStat = entry.hasStat;
+    raw.size = entry.size;
+    add(raw);
+}
+
+void ExpectedDigests::add(const RawManifestEntry& entry) {
+    constexpr std::size_t DigestBytes = sizeof(RawFileDigests::sha256);
+    constexpr std::size_t CrcBytes = sizeof(RawFileDigests::crc32c);
+    static_assert(DigestBytes + CrcBytes + 1 == KeyBytes, "expected digest key layout");
+    // Absent fields stay zero, so they compare equal
+    std::size_t at = keyBytes.size();
+    keyBytes.resize(at + KeyBytes, 0);
+    std::uint8_t present = 0;
+    if (entry.sha256) {
+        std::memcpy(&keyBytes[at], entry.sha256, DigestBytes);
+        present |= HasSha256;
+    }
+    if (entry.crc32c) {
+        std::memcpy(&keyBytes[at + DigestBytes], entry.crc32c, CrcBytes);
+        present |= HasCrc32c;
+    }
+    if (entry.hasStat) present |= HasStat;
+    keyBytes[at + KeyBytes - 1] = present;
+    sizes.push_back(entry.hasStat ? entry.size : 0);
+    pathTable.add(entry.path);
+}
+
+const unsigned char* ExpectedDigests::sha256(std::size_t entry) const {
+    return (fields(entry) & HasSha256) ? &keyBytes[entry * KeyBytes] : nullptr;
+}
+
+const unsigned char* ExpectedDigests::crc32c(std::size_t entry) const {
+    return (fields(entry) & HasCrc32c) ? &keyBytes[entry * KeyBytes + sizeof(RawFileDigests::sha256)] : nullptr;
+}
+
+bool ExpectedDigests::hasStat(std::size_t entry) const {
+    return (fields(entry) & HasStat) != 0;
+}
@@ -0,0 +1,94 @@
+// Results of a batch, kept by field instead of by file.
+//
+// A batch of tens of millions of small files cannot afford a result object,
+// a hex string per digest and a copy of the path for every file: the
+// allocations cost as much as the hashing. Here every field is one array
+// carved out of a single allocation: raw digests, stat data and a status
+// byte per file. Paths go in a PathTable. Hex is only produced when a line
+// is written, by a ManifestWriter.
+#pragma once
+
+#include "digest.h"
+#include "manifest.h"
+#include "pathtable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class BatchResults {
+    public:
+    // Room for 'count' files. The CRC-32C and stat arrays only exist when
+    // asked for.
+    BatchResults(std::size_t count, bool crc32c, bool stat);
+
+    BatchResults(const BatchResults&) = delete;
+    BatchResults& operator=(const BatchResults&) = delete;
+
+    std::size_t size() const { return count; }
+
+    // Workers fill in different files at the same time; no locking needed
+    void setDigests(std::size_t file, const RawFileDigests& digests);
+    void setStat(std::size_t file, std::uint64_t size, std::int64_t mtimeNs);
+    // Same digests and status as another file, e.g. a hard link
+    void copyDigests(std::size_t from, std::size_t to);
+
+    // False until setDigests(), so also for files that could not be read
+    bool ok(std::size_t file) const { return (flags[file] & Hashed) != 0; }
+
+    // The file as a manifest entry, pointing into this store
+    RawManifestEntry entry(std::size_t file, std::string_view path) const;
+
+    private:
+    enum Flags : std::uint8_t { Hashed = 1, HasStat = 2 };
+
+    std::size_t count;
+    std::unique_ptr<unsigned char[]> arena;
+    std::uint64_t* sizes = nullptr;
+    std::int64_t* mtimes = nullptr;
+    unsigned char* sha256 = nullptr;
+    unsigned char* crc32c = nullptr;
+    std::uint8_t* flags = nullptr;
+};
+
+// What a manifest says a batch should hash to, kept the same way. Every
+// entry has one fixed-size key: the raw SHA-256, the raw CRC-32C and a byte
+// telling which fields are there, and its path in one PathTable. check
+// compares digests against these bytes and groups entries by them in
+// planSharing(), so it needs neither a ManifestEntry, a hex string nor a
+// std::string per file.
+class ExpectedDigests {
+    public:
+    // SHA-256, CRC-32C, field byte
+    static constexpr std::size_t KeyBytes = 32 + 4 + 1;
+
+    void reserve(std::size_t entries, std::size_t pathBytes);
+    // A digest that is missing, or in a text manifest not hex, counts as
+    // absent
+    void add(const ManifestEntry& entry);
+    void add(const RawManifestEntry& entry);
+
+    std::size_t size() const { return sizes.size(); }
+    // size() keys, back to back
+    const unsigned char* keys() const { return keyBytes.data(); }
+    // size() paths, by entry
+    const PathTable& paths() const { return pathTable; }
+
+    // Raw digests, nullptr when the manifest has none
+    const unsigned char* sha256(std::size_t entry) const;
+    const unsigned char* crc32c(std::size_t entry) const;
+    // The size recorded by --stat, if any
+    bool hasStat(std::size_t entry) const;
+    std::uint64_t statSize(std::size_t entry) const { return sizes[entry]; }
+
+    private:
+    enum Fields : std::uint8_t { HasSha256 = 1, HasCrc32c = 2, HasStat = 4 };
+
+    std::uint8_t fields(std::size_t entry) const { return keyBytes[entry * KeyBytes + KeyBytes - 1]; }
+
+    std::vector<unsigned char> keyBytes;
+    std::vector<std::uint64_t> sizes;
+    PathTable pathTable;
+};
@@ -0,0 +1,145 @@
+#include "stats.h"
+
+#include "bufpool.h"
+
+#include <iomanip>
+
+namespace {
+
+double ms(std::uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+// MB/s over the given time, 0 when nothing was measured
+double rate(std::uint64_t bytes, std::uint64_t ns) {
+    return ns == 0 ? 0.0 : static_cast<double>(bytes) / 1e6 / (static_cast<double>(ns) / 1e9);
+}
+
+// Which phase dominated. Reads on the mmap backend show up as page faults
+// inside hashing, so this can only say "CPU" for those.
+const char* bound(const IoStats& stats) {
+    if (stats.throttleNs > stats.readNs + stats.hashNs) return "throttle";
+    std::uint64_t io = stats.openNs + stats.readNs;
+    std::uint64_t cpu = stats.hashNs + stats.finalizeNs;
+    if (io == 0 && cpu == 0) return "unknown";
+    return io > cpu ? "I/O" : "CPU";
+}
+
+} // namespace
+
+bool parseStatsFormat(const std::string& name, StatsFormat& format) {
+    if (name == "text") {
+        format = StatsFormat::Text;
+    } else if (name == "json") {
+        format = StatsFormat::Json;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void IoStats::merge(const IoStats& other) {
+    files += other.files;
+    bytes += other.bytes;
+    readCalls += other.readCalls;
+    readBytes += other.readBytes;
+    mappedBytes += other.mappedBytes;
+    openNs += other.openNs;
+    readNs += other.readNs;
+    hashNs += other.hashNs;
+    finalizeNs += other.finalizeNs;
+    throttleNs += other.throttleNs;
+    holeBytes += other.holeBytes;
+    changedFiles += other.changedFiles;
+    for (std::size_t i = 0; i < BackendCount; i++) backendFiles[i] += other.backendFiles[i];
+    residentFiles += other.residentFiles;
+    prefetchedFiles += other.prefetchedFiles;
+    linkedFiles += other.linkedFiles;
+    reflinkedFiles += other.reflinkedFiles;
+    disks += other.disks;
+    rotationalDisks += other.rotationalDisks;
+    tunedWorkers += other.tunedWorkers;
+    tunedBytesPerSec += other.tunedBytesPerSec;
+    tunedDiskDepth += other.tunedDiskDepth;
+}
+
+void printStats(std::ostream& out, const IoStats& stats, std::uint64_t wallNs, StatsFormat format) {
+    // Holes and mappings take no read calls, so they stay out of the average
+    std::uint64_t avgRead = stats.readCalls == 0 ? 0 : stats.readBytes / stats.readCalls;
+    const BufferPool::Usage buffers = BufferPool::instance().usage();
+
+    // "read 3, mmap 1" and {"read":3,"mmap":1}
+    std::string backendsText, backendsJson;
+    for (std::size_t i = 0; i < BackendCount; i++) {
+        if (stats.backendFiles[i] == 0) continue;
+        const char* name = backendName(static_cast<Backend>(i));
+        std::string count = std::to_string(stats.backendFiles[i]);
+        backendsText += (backendsText.empty() ? "" : ", ") + std::string(name) + " " + count;
+        backendsJson += (backendsJson.empty() ? "\"" : ",\"") + std::string(name) + "\":" + count;
+    }
+    // "3 worker(s), 2 read(s) per disk, at 180 MB/s"
+    std::string tunedText = "off";
+    if (stats.tunedWorkers != 0) {
+        tunedText = std::to_string(stats.tunedWorkers) + " worker(s)";
+        if (stats.tunedDiskDepth != 0) tunedText += ", " + std::to_string(stats.tunedDiskDepth) + " read(s) per disk,";
+        tunedText += " at " + std::to_string(stats.tunedBytesPerSec / 1000000) + " MB/s";
+    }
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+
+    if (format == StatsFormat::Json) {
+        out << "{\"files\":" << stats.files
+            << ",\"bytes\":" << stats.bytes
+            << ",\"read_calls\":" << stats.readCalls
+            << ",\"read_bytes\":" << stats.readBytes
+            << ",\"mapped_bytes\":" << stats.mappedBytes
+            << ",\"avg_read_bytes\":" << avgRead
+            << ",\"open_ms\":" << ms(stats.openNs)
+            << ",\"read_ms\":" << ms(stats.readNs)
+            << ",\"hash_ms\":" << ms(stats.hashNs)
+            << ",\"finalize_ms\":" << ms(stats.finalizeNs)
+            << ",\"throttle_ms\":" << ms(stats.throttleNs)
+            << ",\"hole_bytes\":" << stats.holeBytes
+            << ",\"changed_files\":" << stats.changedFiles
+            << ",\"wall_ms\":" << ms(wallNs)
+            << ",\"mb_per_s\":" << rate(stats.bytes, wallNs)
+            << ",\"hash_mb_per_s\":" << rate(stats.bytes, stats.hashNs)
+            << ",\"backends\":{" << backendsJson << "}"
+            << ",\"resident_files\":" << stats.residentFiles
+            << ",\"prefetched_files\":" << stats.prefetchedFiles
+            << ",\"linked_files\":" << stats.linkedFiles
+            << ",\"reflinked_files\":" << stats.reflinkedFiles
+            << ",\"disks\":" << stats.disks
+            << ",\"rotational_disks\":" << stats.rotationalDisks
+            << ",\"tuned_workers\":" << stats.tunedWorkers
+            << ",\"tuned_mb_per_s\":" << stats.tunedBytesPerSec / 1e6
+            << ",\"tuned_disk_depth\":" << stats.tunedDiskDepth
+            << ",\"buffer_peak_bytes\":" << buffers.peakLeased
+            << ",\"buffer_budget_bytes\":" << buffers.budget
+            << ",\"buffer_slabs\":" << buffers.slabs
+            << ",\"buffer_huge_slabs\":" << buffers.hugeSlabs
+            << ",\"bound\":\"" << bound(stats) << "\"}\n";
+    } else if (format == StatsFormat::Text) {
+        out << "files:        " << stats.files << '\n'
+            << "bytes:        " << stats.bytes << '\n'
+            << "read calls:   " << stats.readCalls << " returning " << stats.readBytes << " bytes (avg " << avgRead << " bytes)\n"
+            << "mapped:       " << stats.mappedBytes << " bytes hashed from mappings\n"
+            << "open:         " << ms(stats.openNs) << " ms\n"
+            << "read:         " << ms(stats.readNs) << " ms\n"
+            << "hash:         " << ms(stats.hashNs) << " ms (" << rate(stats.bytes, stats.hashNs) << " MB/s)\n"
+            << "finalize:     " << ms(stats.finalizeNs) << " ms\n"
+            << "throttled:    " << ms(stats.throttleNs) << " ms\n"
+            << "holes:        " << stats.holeBytes << " bytes hashed as zeros without reading\n"
+            << "changed:      " << stats.changedFiles << " file(s) truncated while mapped, not hashed\n"
+            << "wall:         " << ms(wallNs) << " ms (" << rate(stats.bytes, wallNs) << " MB/s)\n"
+            << "backends:     " << (backendsText.empty() ? "none" : backendsText) << '\n'
+            << "page cache:   " << stats.residentFiles << " file(s) resident, hashed first; " << stats.prefetchedFiles << " read ahead\n"
+            << "shared:       " << stats.linkedFiles << " hard link(s), " << stats.reflinkedFiles << " reflink copy(ies) not read again\n"
+            << "disks:        " << stats.disks << " (" << stats.rotationalDisks << " rotational)\n"
+            << "tuned:        " << tunedText << '\n'
+            << "buffers:      " << buffers.peakLeased / 1024 << " KiB peak of " << buffers.budget / 1024 << " KiB budget, "
+            << buffers.slabs << " slab(s), " << buffers.hugeSlabs << " on huge pages\n"
+            << "bound:        " << bound(stats) << '\n';
+    }
+    out.flags(flags);
+}
@@ -0,0 +1,74 @@
+// Per-phase counters for --stats. Everything is accumulated in nanoseconds
+// on the steady clock and only touched when stats were asked for, so the
+// hot loop pays nothing otherwise.
+#pragma once
+
+#include "backend.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+enum class StatsFormat { None, Text, Json };
+
+// Accepts "text" and "json"
+bool parseStatsFormat(const std::string& name, StatsFormat& format);
+
+struct IoStats {
+    std::uint64_t files = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t readCalls = 0;
+    // Returned by those calls, and hashed straight from mappings (--io mmap)
+    std::uint64_t readBytes = 0;
+    std::uint64_t mappedBytes = 0;
+    std::uint64_t openNs = 0;
+    std::uint64_t readNs = 0;
+    std::uint64_t hashNs = 0;
+    std::uint64_t finalizeNs = 0;
+    // Asleep in the --max-rate token bucket
+    std::uint64_t throttleNs = 0;
+    // Hashed as zeros from holes in sparse files, never read (part of bytes)
+    std::uint64_t holeBytes = 0;
+    // Mapped files that shrank while they were hashed, and so failed
+    std::uint64_t changedFiles = 0;
+    // How many files each backend read, to audit --io auto
+    std::array<std::uint64_t, BackendCount> backendFiles{};
+    // Batches: files moved to the front because they were in the page cache,
+    // and files read ahead while others hashed
+    std::uint64_t residentFiles = 0;
+    std::uint64_t prefetchedFiles = 0;
+    // Files that took the result of a hard link or a reflink copy instead
+    // of being read again
+    std::uint64_t linkedFiles = 0;
+    std::uint64_t reflinkedFiles = 0;
+    // Batches: disks the files were spread over, and how many of them spin
+    std::uint64_t disks = 0;
+    std::uint64_t rotationalDisks = 0;
+    // Batches with --tune: the busy worker count that did best, its
+    // throughput in bytes per second and the reads per disk it settled on
+    std::uint64_t tunedWorkers = 0;
+    std::uint64_t tunedBytesPerSec = 0;
+    std::uint64_t tunedDiskDepth = 0;
+
+    void merge(const IoStats& other);
+};
+
+inline std::uint64_t nowNs() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Wall clock for a whole run, started on construction
+class RunTimer {
+    public:
+    RunTimer() : start(nowNs()) {}
+    std::uint64_t elapsedNs() const { return nowNs() - start; }
+
+    private:
+    std::uint64_t start;
+};
+
+// Print the report for a run that took wallNs in total
+void printStats(std::ostream& out, const IoStats& stats, std::uint64_t wallNs, StatsFormat format);
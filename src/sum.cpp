@@ -0,0 +1,184 @@
+// itfl sum: print a manifest line for every file given
+#include "../lib/cxxopts.hpp"
+#include "binmanifest.h"
+#include "commands.h"
+#include "dedup.h"
+#include "digest.h"
+#include "iosched.h"
+#include "manifest.h"
+#include "options.h"
+#include "pathtable.h"
+#include "pool.h"
+#include "prefetch.h"
+#include "progress.h"
+#include "results.h"
+#include "term.h"
+#include "tuner.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+int runSum(int argc, char* argv[]) {
+    cxxopts::Options options("itfl sum", "Compute SHA-256 digests and print them as a manifest\n\nUsage:\n itfl sum [OPTIONS] <files...>");
+    options.add_options()
+        ("crc32c", "Also store a CRC-32C for fast triage with 'itfl check --fast'")
+        ("stat", "Also store each file's size and mtime, so 'itfl diff --rehash' can tell what may have changed")
+        ("hmac-key-file", "Key file: store HMAC-SHA256 instead of plain SHA-256 digests", cxxopts::value<std::string>())
+        ("binary", "Write a binary manifest to this file instead of printing one (implies --stat)", cxxopts::value<std::string>())
+        ("files", "Files to hash", cxxopts::value<std::vector<std::string>>())
+        ("help", "Print usage");
+    addCommonOptions(options);
+    options.parse_positional({"files"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("files") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "No files given. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+    IoStats stats;
+    if (common.statsFormat != StatsFormat::None) {
+        common.read.stats = &stats;
+    }
+    const RunTimer timer;
+
+    DigestRequest request;
+    request.crc32c = result.count("crc32c");
+    std::unique_ptr<HMACSHA256::Key> hmacKey;
+    if (result.count("hmac-key-file")) {
+        hmacKey = readHmacKey(result["hmac-key-file"].as<std::string>());
+        request.hmacKey = hmacKey.get();
+    }
+    const bool binary = result.count("binary");
+    const bool recordStat = binary || result.count("stat");
+    const std::vector<std::string>& files = result["files"].as<std::vector<std::string>>();
+
+    // One string table for the batch, not a second std::string per file
+    PathTable paths;
+    std::size_t pathBytes = 0;
+    for (const std::string& file : files) pathBytes += file.size() + 1;
+    paths.reserve(files.size(), pathBytes);
+    for (const std::string& file : files) paths.add(file);
+
+    // Hard links (and reflink copies) are hashed once, through their first path
+    const SharedPlan shared = planSharing(paths, common.reflinks);
+    // Without links every file leads, and the table is used as it is
+    PathTable leaderPaths;
+    if (shared.leaders.size() != files.size()) {
+        leaderPaths.reserve(shared.leaders.size(), pathBytes);
+        for (std::size_t i : shared.leaders) leaderPaths.add(files[i]);
+    }
+    const PathTable& leaders = shared.leaders.size() != files.size() ? leaderPaths : paths;
+
+    ProgressCounters counters;
+    std::unique_ptr<ProgressReporter> reporter;
+    if (common.progress) {
+        std::uint64_t totalBytes = 0;
+        for (std::size_t i : shared.leaders) totalBytes += fileSize(files[i]);
+        common.read.progress = &counters.bytes;
+        reporter = std::make_unique<ProgressReporter>(counters, totalBytes, files.size());
+    }
+
+    BatchResults results(files.size(), request.crc32c, recordStat);
+    ManifestWriter writer(std::cout);
+    BinaryManifestBuilder builder;
+    if (binary) builder.reserve(files.size());
+    int status = 0;
+
+    // Hash in parallel, print in command line order
+    OrderedEmitter emitter(files.size(), [&](std::size_t i) {
+        if (!results.ok(i)) {
+            if (reporter) reporter->clear();
+            // Lines written so far go out before the error
+            writer.flush();
+            std::cerr << color.red << "Error: " << color.reset << "Could not read file: '" << files[i] << "'.\n";
+            status = 1;
+            return;
+        }
+        if (binary) {
+            builder.add(results.entry(i, files[i]));
+            return;
+        }
+        writer.write(results.entry(i, files[i]));
+        // The progress line shares the terminal, so lines go out one at a time
+        if (reporter) {
+            reporter->clear();
+            writer.flush();
+        }
+    });
+
+    WorkerPool pool(common.jobs, common.topology);
+    std::vector<IoStats> workerStats(pool.size());
+    const BatchPlan plan = planBatch(leaders, common.prefetch);
+    std::unique_ptr<Prefetcher> prefetcher;
+    if (common.prefetch) prefetcher = std::make_unique<Prefetcher>(leaders, plan, pool.size());
+    // With one worker there is never more than one read per disk anyway
+    std::unique_ptr<DeviceScheduler> scheduler;
+    if (pool.size() > 1) scheduler = std::make_unique<DeviceScheduler>(leaders, plan, common.rotationalReaders, common.solidReaders);
+    std::unique_ptr<ConcurrencyTuner> tuner;
+    if (common.tune && scheduler) {
+        common.read.progress = &counters.bytes;
+        tuner = std::make_unique<ConcurrencyTuner>(counters.bytes, pool.size(), [&](std::size_t busy) {
+            scheduler->setLimit(busy);
+            if (prefetcher) prefetcher->setWorkers(busy);
+        }, scheduler->diskLimit(), [&](std::size_t depth) { scheduler->setDiskLimit(depth); });
+    }
+    pool.parallelFor(leaders.size(), [&](std::size_t next, Worker& worker) {
+        std::size_t position = scheduler ? scheduler->take() : next;
+        std::size_t leader = plan.order[position];
+        std::size_t i = shared.leaders[leader];
+        if (prefetcher) prefetcher->started(position);
+        ReadContext ctx = common.read;
+        ctx.node = worker.node;
+        if (ctx.stats) ctx.stats = &workerStats[worker.index];
+        // Stat before reading: a write during the read then shows as a change later
+        std::uint64_t size = 0;
+        std::int64_t mtimeNs = 0;
+        if (recordStat && fileStat(files[i], size, mtimeNs)) results.setStat(i, size, mtimeNs);
+        RawFileDigests digests;
+        if (digestFile(files[i], request, ctx, digests)) results.setDigests(i, digests);
+        for (std::size_t follower : shared.followers[leader]) {
+            results.copyDigests(i, follower);
+            if (recordStat && fileStat(files[follower], size, mtimeNs)) results.setStat(follower, size, mtimeNs);
+        }
+        if (scheduler) scheduler->finished(position);
+        counters.files.fetch_add(1 + shared.followers[leader].size(), std::memory_order_relaxed);
+        emitter.done(i);
+        for (std::size_t follower : shared.followers[leader]) emitter.done(follower);
+    });
+    if (tuner) {
+        tuner->stop();
+        stats.tunedWorkers = tuner->bestWorkers();
+        stats.tunedBytesPerSec = tuner->bestRate();
+        stats.tunedDiskDepth = tuner->bestDepth();
+    }
+    for (const IoStats& workerStat : workerStats) stats.merge(workerStat);
+    stats.linkedFiles = shared.linked;
+    stats.reflinkedFiles = shared.reflinked;
+    stats.residentFiles = plan.resident;
+    if (prefetcher) stats.prefetchedFiles = prefetcher->prefetched();
+    if (scheduler) {
+        stats.disks = scheduler->disks();
+        stats.rotationalDisks = scheduler->rotationalDisks();
+    }
+
+    reporter.reset();
+    writer.flush();
+    if (binary) builder.write(result["binary"].as<std::string>());
+    printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+    if (tuner) printTuning(std::cerr, *tuner, pool.size());
+    return status;
+}
@@ -0,0 +1,172 @@
+// itfl tar: hash the members of a tar archive as it streams by, without
+// extracting it. Prints a manifest of the members, or checks them against
+// one with -c.
+#include "../lib/crc32c.h"
+#include "../lib/cxxopts.hpp"
+#include "../lib/sha256.h"
+#include "binmanifest.h"
+#include "commands.h"
+#include "hasher.h"
+#include "manifest.h"
+#include "options.h"
+#include "progress.h"
+#include "tarstream.h"
+#include "term.h"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace {
+
+// Tar writes "./dir/file" as often as "dir/file"
+std::string normalizePath(const std::string& path) {
+    std::size_t start = 0;
+    while (path.compare(start, 2, "./") == 0) start += 2;
+    return path.substr(start);
+}
+
+} // namespace
+
+int runTar(int argc, char* argv[]) {
+    cxxopts::Options options("itfl tar", "Hash the members of a tar archive without extracting it\n\nUsage:\n itfl tar [OPTIONS] [archive]\n\nReads standard input when the archive is '-' or missing.");
+    options.add_options()
+        ("c,check", "Verify the members against this manifest instead of printing one", cxxopts::value<std::string>())
+        ("crc32c", "Also store a CRC-32C in the printed manifest")
+        ("q,quiet", "Only print members that fail, with -c")
+        ("archive", "Tar archive, '-' for standard input", cxxopts::value<std::string>()->default_value("-"))
+        ("help", "Print usage");
+    addCommonOptions(options);
+    options.parse_positional({"archive"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+    IoStats stats;
+    if (common.statsFormat != StatsFormat::None) {
+        common.read.stats = &stats;
+    }
+    const bool quiet = result.count("quiet");
+    const bool checking = result.count("check");
+
+    // Expected digests by normalized path, and whether the archive had them
+    std::map<std::string, ManifestEntry> expected;
+    std::map<std::string, bool> seen;
+    if (checking) {
+        // A manifest that cannot be opened throws, and is reported as such
+        for (ManifestEntry& entry : loadManifest(result["check"].as<std::string>())) {
+            std::string path = normalizePath(entry.path);
+            seen[path] = false;
+            expected[path] = std::move(entry);
+        }
+    }
+
+    const std::string archiveName = result["archive"].as<std::string>();
+    std::ifstream archiveFile;
+    if (archiveName != "-") {
+        archiveFile.open(archiveName, std::ios::binary);
+        if (!archiveFile) {
+            std::cerr << color.red << "Error: " << color.reset << "Could not open archive: '" << archiveName << "'.\n";
+            return 1;
+        }
+    }
+    std::istream& archive = archiveName == "-" ? std::cin : archiveFile;
+    const RunTimer timer;
+
+    ProgressCounters counters;
+    std::unique_ptr<ProgressReporter> reporter;
+    if (common.progress) {
+        common.read.progress = &counters.bytes;
+        reporter = std::make_unique<ProgressReporter>(counters, archiveName == "-" ? 0 : fileSize(archiveName), 0);
+    }
+
+    std::size_t failed = 0, unreadable = 0;
+    VerdictWriter writer(std::cout);
+    // The progress line shares the terminal, so verdicts go out one at a time
+    auto written = [&] {
+        if (reporter) writer.flush();
+    };
+    TarStream tar(archive, common.read);
+    TarMember member;
+    while (tar.next(member)) {
+        if (!member.regular() && !member.sparse) continue;
+        const std::string path = normalizePath(member.path);
+        if (reporter) reporter->clear();
+        if (member.sparse) {
+            // The archive only holds the data extents, which would give the wrong digest
+            if (!checking) {
+                std::cerr << color.red << "Error: " << color.reset << "Sparse member not supported: '" << member.path << "'.\n";
+                unreadable++;
+            } else if (expected.count(path)) {
+                seen[path] = true;
+                unreadable++;
+                writer.write(member.path, color.red, "FAILED sparse member", color.reset);
+                written();
+            }
+            continue;
+        }
+
+        auto wanted = expected.find(path);
+        if (checking && wanted == expected.end()) continue;
+        bool crc = checking ? wanted->second.sha256.empty() && !wanted->second.crc32c.empty() : result.count("crc32c") > 0;
+
+        if (common.read.stats) common.read.stats->files++;
+        HasherSet<SHA256, CRC32C> hashers;
+        hashers.enable<0>(!checking || !crc);
+        hashers.enable<1>(crc);
+        tar.content(hashers);
+        counters.files.fetch_add(1, std::memory_order_relaxed);
+
+        std::uint64_t start = common.read.stats ? nowNs() : 0;
+        ManifestEntry entry;
+        entry.path = member.path;
+        if (hashers.isEnabled<0>()) entry.sha256 = hashers.get<0>().getHash();
+        if (hashers.isEnabled<1>()) entry.crc32c = hashers.get<1>().getHash();
+        if (common.read.stats) common.read.stats->finalizeNs += nowNs() - start;
+
+        if (!checking) {
+            writeManifestEntry(std::cout, entry);
+            continue;
+        }
+        seen[path] = true;
+        bool ok = crc ? entry.crc32c == wanted->second.crc32c : entry.sha256 == wanted->second.sha256;
+        if (ok) {
+            if (!quiet) writer.write(member.path, color.green, "OK", color.reset);
+        } else {
+            failed++;
+            writer.write(member.path, color.red, "FAILED", color.reset);
+        }
+        written();
+    }
+
+    // Listed in the manifest but not in the archive
+    for (const auto& entry : seen) {
+        if (entry.second) continue;
+        if (reporter) reporter->clear();
+        unreadable++;
+        writer.write(expected[entry.first].path, color.red, "FAILED not in archive", color.reset);
+        written();
+    }
+
+    reporter.reset();
+    writer.flush();
+    printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+    if (failed > 0) {
+        std::cerr << "itfl: WARNING: " << failed << " computed checksum" << (failed == 1 ? "" : "s") << " did NOT match\n";
+    }
+    if (unreadable > 0) {
+        std::cerr << "itfl: WARNING: " << unreadable << (checking ? " listed file" : " member") << (unreadable == 1 ? "" : "s") << " could not be read\n";
+    }
+    return (failed > 0 || unreadable > 0) ? 1 : 0;
+}
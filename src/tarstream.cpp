@@ -0,0 +1,231 @@
+#include "tarstream.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::size_t BlockSize = 512;
+// Long names and pax headers bigger than this are not names
+constexpr std::uint64_t MaxHeaderText = 1 << 20;
+
+// Header field offsets and lengths
+enum : std::size_t {
+    NameAt = 0, NameLength = 100,
+    SizeAt = 124, SizeLength = 12,
+    ChecksumAt = 148, ChecksumLength = 8,
+    TypeAt = 156,
+    MagicAt = 257,
+    PrefixAt = 345, PrefixLength = 155,
+};
+
+// NUL terminated or full width
+std::string field(const char* header, std::size_t at, std::size_t length) {
+    const char* start = header + at;
+    return std::string(start, strnlen(start, length));
+}
+
+// Octal with leading spaces, or base-256 when the top bit of the first byte
+// is set (GNU, for sizes of 8 GiB and up). Returns false if neither.
+bool number(const char* header, std::size_t at, std::size_t length, std::uint64_t& value) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(header + at);
+    value = 0;
+    if (p[0] & 0x80) {
+        if (p[0] != 0x80) return false;
+        for (std::size_t i = 1; i < length; i++) {
+            if (value >> 56) return false;
+            value = (value << 8) | p[i];
+        }
+        return true;
+    }
+    std::size_t i = 0;
+    while (i < length && p[i] == ' ') i++;
+    bool digits = false;
+    for (; i < length && p[i] >= '0' && p[i] <= '7'; i++) {
+        value = (value << 3) | static_cast<std::uint64_t>(p[i] - '0');
+        digits = true;
+    }
+    // Terminated by NUL or space, or running to the end of the field
+    return digits && (i == length || p[i] == '\0' || p[i] == ' ');
+}
+
+// The checksum treats its own field as spaces. Old tars summed signed chars.
+bool checksumOk(const char* header) {
+    std::uint64_t stored = 0;
+    if (!number(header, ChecksumAt, ChecksumLength, stored)) return false;
+    std::uint64_t sum = 0;
+    std::int64_t signedSum = 0;
+    for (std::size_t i = 0; i < BlockSize; i++) {
+        bool inField = i >= ChecksumAt && i < ChecksumAt + ChecksumLength;
+        sum += inField ? ' ' : static_cast<unsigned char>(header[i]);
+        signedSum += inField ? ' ' : static_cast<signed char>(header[i]);
+    }
+    return stored == sum || static_cast<std::int64_t>(stored) == signedSum;
+}
+
+bool zeroBlock(const char* header) {
+    for (std::size_t i = 0; i < BlockSize; i++) {
+        if (header[i] != 0) return false;
+    }
+    return true;
+}
+
+std::uint64_t paddingFor(std::uint64_t size) {
+    return (BlockSize - size % BlockSize) % BlockSize;
+}
+
+} // namespace
+
+TarStream::TarStream(std::istream& in, const ReadContext& ctx)
+    : in(in), ctx(ctx), lease(BufferPool::instance().acquire(ctx.node)), buf(lease.data()) {}
+
+std::size_t TarStream::fill(std::size_t want) {
+    if (end - begin >= want) return end - begin;
+    // Slide what is left to the front, then top the buffer up
+    std::memmove(buf, buf + begin, end - begin);
+    bufOffset += begin;
+    end -= begin;
+    begin = 0;
+
+    IoStats* stats = ctx.stats;
+    while (end < want && in) {
+        std::uint64_t start = stats ? nowNs() : 0;
+        in.read(buf + end, static_cast<std::streamsize>(io::BufferSize - end));
+        std::size_t got = static_cast<std::size_t>(in.gcount());
+        if (stats) {
+            stats->readNs += nowNs() - start;
+            stats->readCalls++;
+        }
+        io::pace(ctx, got);
+        end += got;
+    }
+    if (in.bad()) throw std::runtime_error("tar: read error at byte " + std::to_string(bufOffset + end));
+    return end - begin;
+}
+
+void TarStream::skip(std::uint64_t bytes) {
+    while (bytes > 0) {
+        if (begin == end && fill(1) == 0) truncated();
+        std::size_t take = end - begin;
+        if (take > bytes) take = static_cast<std::size_t>(bytes);
+        begin += take;
+        bytes -= take;
+    }
+}
+
+std::string TarStream::text() {
+    if (remaining > MaxHeaderText) malformed("extended header too long");
+    std::string result;
+    result.reserve(static_cast<std::size_t>(remaining));
+    while (remaining > 0) {
+        if (begin == end && fill(1) == 0) truncated();
+        std::size_t take = end - begin;
+        if (take > remaining) take = static_cast<std::size_t>(remaining);
+        result.append(buf + begin, take);
+        begin += take;
+        remaining -= take;
+    }
+    return result;
+}
+
+void TarStream::truncated() const {
+    throw std::runtime_error("tar: archive truncated at byte " + std::to_string(bufOffset + end));
+}
+
+void TarStream::malformed(const std::string& what) const {
+    throw std::runtime_error("tar: " + what + " at byte " + std::to_string(bufOffset + begin));
+}
+
+bool TarStream::next(TarMember& member) {
+    skip(remaining + padding);
+    remaining = padding = 0;
+
+    // Set by the extension headers in front of the member they describe
+    std::string longName, paxPath;
+    std::uint64_t paxSize = 0;
+    bool hasPaxSize = false, paxSparse = false;
+
+    for (;;) {
+        std::size_t available = fill(BlockSize);
+        // Archives cut right after a member, without end blocks, are common enough
+        if (available == 0) return false;
+        if (available < BlockSize) truncated();
+
+        const char* header = buf + begin;
+        if (zeroBlock(header)) {
+            begin += BlockSize;
+            return false;
+        }
+        if (!checksumOk(header)) malformed("bad header checksum");
+        std::uint64_t size = 0;
+        if (!number(header, SizeAt, SizeLength, size)) malformed("bad size field");
+        char type = header[TypeAt];
+
+        member = TarMember();
+        member.type = type;
+        member.path = field(header, NameAt, NameLength);
+        // POSIX ustar splits long paths into prefix/name; GNU uses "ustar  " and no prefix
+        if (std::memcmp(header + MagicAt, "ustar\0", 6) == 0) {
+            std::string prefix = field(header, PrefixAt, PrefixLength);
+            if (!prefix.empty()) member.path = prefix + '/' + member.path;
+        }
+        begin += BlockSize;
+        remaining = size;
+        padding = paddingFor(size);
+
+        switch (type) {
+        case 'L':
+            longName = text();
+            longName.resize(strnlen(longName.c_str(), longName.size()));
+            skip(padding);
+            padding = 0;
+            continue;
+        case 'x': {
+            // Records are "<length> <key>=<value>\n", length counting the whole record
+            std::string records = text();
+            skip(padding);
+            padding = 0;
+            std::size_t pos = 0;
+            while (pos < records.size()) {
+                std::size_t space = records.find(' ', pos);
+                if (space == std::string::npos) malformed("bad pax record");
+                std::uint64_t length = std::strtoull(records.c_str() + pos, nullptr, 10);
+                if (length <= space - pos || pos + length > records.size()) malformed("bad pax record");
+                std::string record = records.substr(space + 1, pos + length - space - 2);
+                pos += length;
+                std::size_t equals = record.find('=');
+                if (equals == std::string::npos) continue;
+                std::string key = record.substr(0, equals), value = record.substr(equals + 1);
+                if (key == "path") {
+                    paxPath = value;
+                } else if (key == "size") {
+                    paxSize = std::strtoull(value.c_str(), nullptr, 10);
+                    hasPaxSize = true;
+                } else if (key.compare(0, 11, "GNU.sparse.") == 0) {
+                    // The real name of a sparse member hides in here
+                    if (key == "GNU.sparse.name") paxPath = value;
+                    paxSparse = true;
+                }
+            }
+            continue;
+        }
+        case 'K':
+        case 'g':
+            // Long link names and global headers do not change what we hash
+            skip(remaining + padding);
+            remaining = padding = 0;
+            continue;
+        }
+
+        if (!longName.empty()) member.path = longName;
+        if (!paxPath.empty()) member.path = paxPath;
+        if (hasPaxSize) {
+            remaining = paxSize;
+            padding = paddingFor(paxSize);
+        }
+        member.size = remaining;
+        member.sparse = type == 'S' || paxSparse;
+        return true;
+    }
+}
@@ -0,0 +1,75 @@
+// Reads a tar archive front to back from any stream, e.g. a pipe, and hands
+// out member contents straight from its read buffer, so members can be
+// hashed as they flow past without ever being extracted.
+//
+// Understands ustar (with the prefix field), GNU long names ('L'/'K') and
+// base-256 sizes, and pax extended headers ('x', the path and size keys).
+// Malformed archives throw std::runtime_error naming the byte offset.
+#pragma once
+
+#include "bufpool.h"
+#include "reader.h"
+
+#include <cstdint>
+#include <istream>
+#include <string>
+
+struct TarMember {
+    std::string path;
+    // Typeflag from the header: '0' for a file, '5' a directory and so on
+    char type = '0';
+    // Bytes of content stored in the archive
+    std::uint64_t size = 0;
+    // GNU sparse members store only their data extents, so their content
+    // is not the file's bytes
+    bool sparse = false;
+
+    bool regular() const { return type == '0' || type == '\0' || type == '7'; }
+};
+
+class TarStream {
+    public:
+    TarStream(std::istream& in, const ReadContext& ctx);
+
+    TarStream(const TarStream&) = delete;
+    TarStream& operator=(const TarStream&) = delete;
+
+    // Move to the next member, skipping whatever is left of the current one.
+    // Returns false at the end of the archive.
+    bool next(TarMember& member);
+
+    // Feed the rest of the current member's content to the sink
+    template <typename Sink>
+    void content(Sink& sink) {
+        while (remaining > 0) {
+            if (begin == end && fill(1) == 0) truncated();
+            std::size_t take = end - begin;
+            if (take > remaining) take = static_cast<std::size_t>(remaining);
+            io::feed(sink, buf + begin, take, ctx);
+            begin += take;
+            remaining -= take;
+        }
+    }
+
+    private:
+    // Make at least 'want' bytes (at most io::BufferSize) available in the
+    // buffer. Returns how many are, fewer only at the end of the input.
+    std::size_t fill(std::size_t want);
+    void skip(std::uint64_t bytes);
+    // Content of the current member as a string, for long names and pax records
+    std::string text();
+    [[noreturn]] void truncated() const;
+    [[noreturn]] void malformed(const std::string& what) const;
+
+    std::istream& in;
+    const ReadContext& ctx;
+    BufferPool::Lease lease;
+    char* buf;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    // Archive offset of buf[0]
+    std::uint64_t bufOffset = 0;
+    // Content bytes of the current member not consumed yet, and the padding after them
+    std::uint64_t remaining = 0;
+    std::uint64_t padding = 0;
+};
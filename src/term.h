@@ -0,0 +1,44 @@
+// Terminal helpers shared by every itfl command
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Windows specific imports, for color right now
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#define IS_TTY _isatty
+#define FILENO _fileno
+#else
+#include <unistd.h>
+#define IS_TTY isatty
+#define FILENO fileno
+#endif
+
+// To manage terminal colors
+class TerminalColor {
+    public:
+    const std::string red;
+    const std::string green;
+    const std::string blue;
+    const std::string reset;
+
+    // Set the ansi codes if the term isnt a TTY. Logic is in the private func
+    TerminalColor() :
+        red(colorSupport() ? "\033[31m" : ""),
+        green(colorSupport() ? "\033[32m" : ""),
+        blue(colorSupport() ? "\033[34m" : ""),
+        reset(colorSupport() ? "\033[0m" : "")
+    {}
+    
+    private:
+    bool colorSupport() const {
+        #ifdef _WIN32
+        // For now, just use normal text if user is on Windows.
+        return false;
+        #else
+        return IS_TTY(FILENO(stdout));
+        #endif
+    }
+};
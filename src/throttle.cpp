@@ -0,0 +1,74 @@
+#include "throttle.h"
+
+#include "stats.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// From linux/ioprio.h, which glibc does not wrap
+constexpr int IoprioWhoProcess = 1;
+constexpr int IoprioClassIdle = 3;
+constexpr int IoprioClassShift = 13;
+
+} // namespace
+
+Throttle::Throttle(std::uint64_t bytesPerSecond) :
+    rate(static_cast<double>(bytesPerSecond)),
+    burst(static_cast<double>(bytesPerSecond) / 4.0),
+    tokens(static_cast<double>(bytesPerSecond) / 4.0),
+    lastNs(nowNs())
+{}
+
+std::uint64_t Throttle::consume(std::uint64_t bytes) {
+    std::uint64_t waitNs = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::uint64_t now = nowNs();
+        tokens += rate * static_cast<double>(now - lastNs) / 1e9;
+        if (tokens > burst) tokens = burst;
+        lastNs = now;
+
+        // Go into debt and sleep it off, rather than refusing the read
+        tokens -= static_cast<double>(bytes);
+        if (tokens < 0) {
+            waitNs = static_cast<std::uint64_t>(-tokens / rate * 1e9);
+            sleptNs += waitNs;
+        }
+    }
+    if (waitNs > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+    }
+    return waitNs;
+}
+
+std::uint64_t Throttle::throttledNs() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return sleptNs;
+}
+
+bool applyIdlePriority(std::string& error) {
+#ifdef __linux__
+    if (syscall(SYS_ioprio_set, IoprioWhoProcess, 0, IoprioClassIdle << IoprioClassShift) != 0) {
+        error = std::string("ioprio_set: ") + std::strerror(errno);
+        return false;
+    }
+    sched_param param{};
+    if (sched_setscheduler(0, SCHED_IDLE, &param) != 0) {
+        error = std::string("sched_setscheduler: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    error = "idle scheduling is only supported on Linux";
+    return false;
+#endif
+}
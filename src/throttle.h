@@ -0,0 +1,36 @@
+// Keeping itfl out of the way of other work on the host: a token bucket
+// that caps read bandwidth, and the idle I/O and CPU scheduling classes.
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Token bucket over bytes. Callers debit what they just read and get put
+// to sleep once the bucket runs dry, so the average rate never exceeds the
+// limit and bursts are bounded by a quarter second worth of tokens.
+// Safe to share between threads.
+class Throttle {
+    public:
+    explicit Throttle(std::uint64_t bytesPerSecond);
+
+    // Account for 'bytes' just read, sleeping if over budget.
+    // Returns the nanoseconds spent asleep.
+    std::uint64_t consume(std::uint64_t bytes);
+
+    // Total time spent asleep so far, across all callers
+    std::uint64_t throttledNs() const;
+
+    private:
+    const double rate;
+    const double burst;
+    mutable std::mutex lock;
+    double tokens;
+    std::uint64_t lastNs;
+    std::uint64_t sleptNs = 0;
+};
+
+// Put the process in the idle I/O class (ioprio_set) and SCHED_IDLE, so it
+// only gets disk and CPU time nobody else wants. Threads started afterwards
+// inherit both. Returns false and fills 'error' if either call failed.
+bool applyIdlePriority(std::string& error);
@@ -0,0 +1,225 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Largest CPU number plus one that affinity masks can hold
+#ifdef __linux__
+constexpr long CpuLimit = CPU_SETSIZE;
+#else
+constexpr long CpuLimit = 1024;
+#endif
+
+bool readCpuList(const std::string& path, std::vector<int>& cpus) {
+    std::ifstream in(path);
+    std::string text;
+    if (!in || !std::getline(in, text)) return false;
+    return parseCpuList(text, cpus);
+}
+
+// Order a node's CPUs so that every core comes once before any core comes
+// twice: the first hardware thread of each core, then the second, and so
+// on. CPUs whose siblings are unknown count as cores of their own.
+void spreadOverCores(std::vector<int>& cpus) {
+    const std::filesystem::path cpuDir = std::filesystem::path(sysfsRoot()) / "devices/system/cpu";
+    std::vector<std::pair<std::size_t, int>> ranked;
+    ranked.reserve(cpus.size());
+    for (int cpu : cpus) {
+        std::vector<int> siblings;
+        std::size_t rank = 0;
+        if (readCpuList((cpuDir / ("cpu" + std::to_string(cpu)) / "topology/thread_siblings_list").string(), siblings)) {
+            rank = static_cast<std::size_t>(std::lower_bound(siblings.begin(), siblings.end(), cpu) - siblings.begin());
+        }
+        ranked.emplace_back(rank, cpu);
+    }
+    std::sort(ranked.begin(), ranked.end());
+    for (std::size_t i = 0; i < cpus.size(); i++) cpus[i] = ranked[i].second;
+}
+
+// CPUs the scheduler lets us use (taskset, cgroup cpusets)
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < count; cpu++) cpus.push_back(static_cast<int>(cpu));
+    }
+    return cpus;
+}
+
+// "<quota> <period>" in microseconds, or "max <period>"
+std::size_t readCpuMax(const std::filesystem::path& path) {
+    std::ifstream in(path);
+    std::string quota;
+    std::uint64_t period = 0;
+    if (!(in >> quota >> period) || quota == "max" || period == 0) return 0;
+    std::uint64_t microseconds = std::strtoull(quota.c_str(), nullptr, 10);
+    if (microseconds == 0) return 0;
+    return static_cast<std::size_t>((microseconds + period - 1) / period);
+}
+
+} // namespace
+
+std::size_t cgroupCpuLimit() {
+    // The v2 entry is the one with hierarchy 0 and no controller list
+    std::ifstream self("/proc/self/cgroup");
+    std::string line, path;
+    while (std::getline(self, line)) {
+        if (line.compare(0, 3, "0::") == 0) path = line.substr(3);
+    }
+    if (path.empty() || path[0] != '/') return 0;
+
+    const std::filesystem::path mount = std::filesystem::path(sysfsRoot()) / "fs/cgroup";
+    std::filesystem::path dir = mount;
+    std::size_t limit = 0;
+    auto tighten = [&] {
+        std::size_t cpus = readCpuMax(dir / "cpu.max");
+        if (cpus != 0 && (limit == 0 || cpus < limit)) limit = cpus;
+    };
+    tighten();
+    for (const std::filesystem::path& part : std::filesystem::path(path).relative_path()) {
+        dir /= part;
+        tighten();
+    }
+    return limit;
+}
+
+std::string sysfsRoot() {
+    const char* root = std::getenv("ITFL_SYSFS_ROOT");
+    return root && *root ? root : "/sys";
+}
+
+bool parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    cpus.clear();
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        std::size_t end = text.find(',', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string range = text.substr(pos, end - pos);
+        while (!range.empty() && std::isspace(static_cast<unsigned char>(range.back()))) range.pop_back();
+        if (!range.empty()) {
+            std::size_t dash = range.find('-');
+            char* tail = nullptr;
+            long first = std::strtol(range.c_str(), &tail, 10);
+            if (tail == range.c_str() || first < 0) return false;
+            long last = first;
+            if (dash != std::string::npos) {
+                const char* lastText = range.c_str() + dash + 1;
+                last = std::strtol(lastText, &tail, 10);
+                if (tail == lastText || last < first) return false;
+            }
+            // No CPU past what an affinity mask can name
+            if (last >= CpuLimit) return false;
+            if (*tail != '\0') return false;
+            for (long cpu = first; cpu <= last; cpu++) cpus.push_back(static_cast<int>(cpu));
+        }
+        pos = end + 1;
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return !cpus.empty();
+}
+
+CpuTopology CpuTopology::detect() {
+    CpuTopology topology;
+    const std::filesystem::path nodeDir = std::filesystem::path(sysfsRoot()) / "devices/system/node";
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(nodeDir, error)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+            continue;
+        }
+        Node node;
+        node.id = std::atoi(name.c_str() + 4);
+        if (readCpuList((entry.path() / "cpulist").string(), node.cpus)) {
+            topology.nodes.push_back(std::move(node));
+        }
+    }
+    std::sort(topology.nodes.begin(), topology.nodes.end(),
+              [](const Node& a, const Node& b) { return a.id < b.id; });
+    for (Node& node : topology.nodes) spreadOverCores(node.cpus);
+
+    std::vector<int> allowed = allowedCpus();
+    if (topology.nodes.empty()) {
+        topology.nodes.push_back(Node{0, allowed});
+        spreadOverCores(topology.nodes.back().cpus);
+    } else if (!std::getenv("ITFL_SYSFS_ROOT")) {
+        // A simulated layout may name CPUs this box does not have; keep them
+        topology.restrict(allowed);
+        if (topology.nodes.empty()) {
+            topology.nodes.push_back(Node{0, allowed});
+            spreadOverCores(topology.nodes.back().cpus);
+        }
+    }
+    return topology;
+}
+
+void CpuTopology::restrict(const std::vector<int>& allowed) {
+    for (Node& node : nodes) {
+        node.cpus.erase(std::remove_if(node.cpus.begin(), node.cpus.end(), [&](int cpu) {
+            return !std::binary_search(allowed.begin(), allowed.end(), cpu);
+        }), node.cpus.end());
+    }
+    nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [](const Node& node) {
+        return node.cpus.empty();
+    }), nodes.end());
+}
+
+std::size_t CpuTopology::cpuCount() const {
+    std::size_t count = 0;
+    for (const Node& node : nodes) count += node.cpus.size();
+    return count;
+}
+
+std::vector<int> CpuTopology::placement(std::size_t workers) const {
+    std::vector<int> cpus;
+    if (nodes.empty()) return cpus;
+    cpus.reserve(workers);
+    for (std::size_t i = 0; i < workers; i++) {
+        const Node& node = nodes[i % nodes.size()];
+        cpus.push_back(node.cpus[(i / nodes.size()) % node.cpus.size()]);
+    }
+    return cpus;
+}
+
+int CpuTopology::nodeOf(int cpu) const {
+    for (const Node& node : nodes) {
+        if (std::find(node.cpus.begin(), node.cpus.end(), cpu) != node.cpus.end()) return node.id;
+    }
+    return -1;
+}
+
+bool pinCurrentThread(int cpu) {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CpuLimit) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
@@ -0,0 +1,55 @@
+// CPU and NUMA layout of the host, read straight from sysfs.
+//
+// Set ITFL_SYSFS_ROOT to point at a copy of /sys to try a different
+// layout, e.g. a fake two-node machine on a laptop.
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// "/sys", or ITFL_SYSFS_ROOT when set
+std::string sysfsRoot();
+
+// CPUs' worth of time the cgroup v2 cpu.max quotas of this process allow,
+// rounded up, the tightest of its cgroup and all parents. 0 when there is
+// no quota or no cgroup v2 hierarchy.
+std::size_t cgroupCpuLimit();
+
+// Parse a kernel cpu list such as "0-3,8,10-11". Returns false if malformed
+// or if a CPU is beyond what an affinity mask can hold (CPU_SETSIZE).
+bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+class CpuTopology {
+    public:
+    // Nodes and their CPUs, limited to the CPUs this process may run on.
+    // Without NUMA information everything ends up on a single node 0. Each
+    // node lists one hardware thread of every core before the SMT siblings
+    // (thread_siblings_list).
+    static CpuTopology detect();
+
+    // Drop every CPU not in 'allowed'. Nodes left without CPUs are removed.
+    void restrict(const std::vector<int>& allowed);
+
+    std::size_t nodeCount() const { return nodes.size(); }
+    std::size_t cpuCount() const;
+
+    // CPU for each of 'workers' threads: round robin over the nodes so
+    // memory bandwidth of every socket gets used, and over the CPUs inside
+    // a node in the order above, so threads do not share a core while a
+    // core is idle.
+    std::vector<int> placement(std::size_t workers) const;
+
+    // Node owning a CPU, -1 if unknown
+    int nodeOf(int cpu) const;
+
+    private:
+    struct Node {
+        int id;
+        std::vector<int> cpus;
+    };
+    std::vector<Node> nodes;
+};
+
+// Pin the calling thread to one CPU. Returns false if the kernel refused.
+bool pinCurrentThread(int cpu);
@@ -0,0 +1,111 @@
+#include "tree.h"
+
+#include "../lib/sha256.h"
+#include "../lib/sha256fixed.h"
+#include "hex.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+typedef sha256fixed::Digest Digest;
+
+const unsigned char LeafPrefix = sha256fixed::LeafPrefix;
+
+// Fold the leaves level by level into the root
+Digest root(std::vector<Digest> level) {
+    while (level.size() > 1) {
+        std::size_t pairs = level.size() / 2;
+        for (std::size_t i = 0; i < pairs; i++) {
+            level[i] = sha256fixed::combine(level[2 * i], level[2 * i + 1]);
+        }
+        if (level.size() % 2) level[pairs] = level.back();
+        level.resize(pairs + level.size() % 2);
+    }
+    return level.front();
+}
+
+std::string hexRoot(std::vector<Digest> leaves) {
+    Digest digest = root(std::move(leaves));
+    return toHex(digest.data(), digest.size());
+}
+
+std::size_t chunkCount(std::uint64_t length) {
+    return length == 0 ? 1 : static_cast<std::size_t>((length + TreeChunkSize - 1) / TreeChunkSize);
+}
+
+} // namespace
+
+bool treeHashFile(const std::string& filename, const ReadContext& ctx, std::string& hex) {
+#ifndef _WIN32
+    IoStats* stats = ctx.stats;
+    std::uint64_t start = stats ? nowNs() : 0;
+    if (stats) stats->files++;
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    std::uint64_t size = 0, offset = 0, length = 0;
+    bool opened = fd >= 0 && fstat(fd, &st) == 0 && objectSize(fd, st, size) && resolveRange(ctx, size, offset, length);
+    if (stats) stats->openNs += nowNs() - start;
+    if (!opened) {
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    if (stats) stats->backendFiles[static_cast<std::size_t>(Backend::Pread)]++;
+
+    std::vector<Digest> leaves(chunkCount(length));
+    std::vector<char> ok(leaves.size(), 0);
+    auto hashChunk = [&](std::size_t i, const ReadContext& chunkCtx) {
+        std::uint64_t chunkStart = offset + i * TreeChunkSize;
+        std::uint64_t chunkLength = std::min(TreeChunkSize, offset + length - chunkStart);
+        SHA256 sha;
+        sha.add(&LeafPrefix, 1);
+        ok[i] = io::readRange(fd, chunkStart, chunkLength, sha, chunkCtx);
+        sha.getHash(leaves[i].data());
+    };
+
+    if (ctx.pool && ctx.pool->size() > 1 && leaves.size() > 1) {
+        // Workers keep their own counters, merged once they are done
+        std::vector<IoStats> workerStats(ctx.pool->size());
+        ctx.pool->parallelFor(leaves.size(), [&](std::size_t i, Worker& worker) {
+            ReadContext chunkCtx = ctx;
+            chunkCtx.node = worker.node;
+            if (stats) chunkCtx.stats = &workerStats[worker.index];
+            hashChunk(i, chunkCtx);
+        });
+        if (stats) {
+            for (const IoStats& workerStat : workerStats) stats->merge(workerStat);
+        }
+    } else {
+        for (std::size_t i = 0; i < leaves.size(); i++) hashChunk(i, ctx);
+    }
+    ::close(fd);
+    for (char chunkOk : ok) {
+        if (!chunkOk) return false;
+    }
+
+    start = stats ? nowNs() : 0;
+    hex = hexRoot(std::move(leaves));
+    if (stats) stats->finalizeNs += nowNs() - start;
+    return true;
+#else
+    (void)filename;
+    (void)ctx;
+    (void)hex;
+    return false;
+#endif
+}
+
+std::string treeHashMemory(const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::vector<Digest> leaves(chunkCount(size));
+    for (std::size_t i = 0; i < leaves.size(); i++) {
+        std::size_t chunkStart = i * TreeChunkSize;
+        SHA256 sha;
+        sha.add(&LeafPrefix, 1);
+        sha.add(bytes + chunkStart, std::min<std::size_t>(TreeChunkSize, size - chunkStart));
+        sha.getHash(leaves[i].data());
+    }
+    return hexRoot(std::move(leaves));
+}
@@ -0,0 +1,24 @@
+// sha256tree: a chunk-tree digest whose leaves can be hashed in parallel.
+//
+// The input is cut into TreeChunkSize chunks. Each leaf is the SHA-256 of a
+// 0x00 byte and one chunk (an empty input has one empty leaf), each node is
+// the SHA-256 of a 0x01 byte and its two children's digests, and a node
+// without a partner moves up a level unchanged. The prefixes (RFC 6962)
+// keep the digests of two children from passing for a chunk. The root is the digest. Because every chunk is read at
+// its own offset with pread(), one file or device range can be split over
+// the workers in ReadContext::pool.
+#pragma once
+
+#include "reader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+constexpr std::uint64_t TreeChunkSize = std::uint64_t(1) << 20;
+
+// Hash a file, or the range in ctx, into a hex digest. Returns false if it
+// could not be read.
+bool treeHashFile(const std::string& filename, const ReadContext& ctx, std::string& hex);
+
+std::string treeHashMemory(const void* data, std::size_t size);
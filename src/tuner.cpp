@@ -0,0 +1,167 @@
+#include "tuner.h"
+
+#include "stats.h"
+#include "topology.h"
+
+#include <chrono>
+#include <vector>
+
+namespace {
+
+// Long enough to average over a few files, short enough to adapt in a run
+// of a few seconds
+constexpr auto Interval = std::chrono::milliseconds(250);
+// Intervals measured for every value tried. The interval right after a
+// change is not counted: it still runs partly on the old setting.
+constexpr unsigned SamplesPerValue = 2;
+// A value has to beat a smaller one by this much to count as better, so
+// noise does not buy extra readers
+constexpr double Tolerance = 0.05;
+
+} // namespace
+
+ConcurrencyTuner::ConcurrencyTuner(const std::atomic<std::uint64_t>& bytes, std::size_t workers, std::function<void(std::size_t)> apply,
+                                   std::size_t depth, std::function<void(std::size_t)> applyDepth)
+    : bytes(bytes) {
+    if (workers == 0) workers = 1;
+    Knob busy;
+    busy.highest = workers;
+    busy.current = workers;
+    busy.apply = std::move(apply);
+    knobs.push_back(std::move(busy));
+    if (depth > 0 && applyDepth) {
+        Knob perDisk;
+        perDisk.highest = workers;
+        perDisk.current = depth < workers ? depth : workers;
+        perDisk.apply = std::move(applyDepth);
+        knobs.push_back(std::move(perDisk));
+    }
+    for (Knob& knob : knobs) {
+        knob.rates.assign(knob.highest + 1, 0.0);
+        knob.samples.assign(knob.highest + 1, 0);
+        knob.apply(knob.current);
+    }
+    thread = std::thread([this] { run(); });
+}
+
+ConcurrencyTuner::~ConcurrencyTuner() {
+    stop();
+}
+
+void ConcurrencyTuner::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping) return;
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+std::size_t ConcurrencyTuner::bestWorkers() {
+    std::lock_guard<std::mutex> guard(lock);
+    return knobs[0].best;
+}
+
+std::uint64_t ConcurrencyTuner::bestRate() {
+    std::lock_guard<std::mutex> guard(lock);
+    return bestBytesPerSecond;
+}
+
+std::size_t ConcurrencyTuner::bestDepth() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (knobs.size() < 2) return 0;
+    // Not reached yet: still the starting limit
+    return knobs[1].best != 0 ? knobs[1].best : knobs[1].current;
+}
+
+std::size_t ConcurrencyTuner::steps() {
+    std::lock_guard<std::mutex> guard(lock);
+    return changes;
+}
+
+bool ConcurrencyTuner::converged() {
+    std::lock_guard<std::mutex> guard(lock);
+    return settled;
+}
+
+void printTuning(std::ostream& out, ConcurrencyTuner& tuner, std::size_t workers) {
+    std::size_t best = tuner.bestWorkers();
+    out << "itfl: tuned ";
+    if (best == 0) {
+        out << "nothing, the run was too short";
+    } else {
+        out << "to " << best << " of " << workers << " worker(s)";
+        std::size_t depth = tuner.bestDepth();
+        if (depth != 0) out << ", " << depth << " read(s) per disk,";
+        out << " at " << tuner.bestRate() / 1000000 << " MB/s after " << tuner.steps() << " step(s)";
+        if (!tuner.converged()) out << ", still probing";
+    }
+    std::size_t quota = cgroupCpuLimit();
+    if (quota != 0) out << "; cgroup CPU quota " << quota;
+    out << '\n';
+}
+
+bool ConcurrencyTuner::climb(Knob& knob, double rate) {
+    std::size_t at = knob.current;
+    knob.rates[at] = (knob.rates[at] * knob.samples[at] + rate) / (knob.samples[at] + 1);
+    knob.samples[at]++;
+    if (knob.samples[at] < SamplesPerValue) return true;
+
+    knob.best = 0;
+    for (std::size_t n = 1; n <= knob.highest; n++) {
+        if (knob.samples[n] < SamplesPerValue) continue;
+        if (knob.best == 0 || knob.rates[n] > knob.rates[knob.best] * (1.0 + Tolerance)) knob.best = n;
+    }
+    // Try whichever neighbour of the best value is not measured yet, fewer
+    // readers first; once both are, the best value holds
+    std::size_t best = knob.best;
+    if (best > 1 && knob.samples[best - 1] < SamplesPerValue) {
+        knob.current = best - 1;
+    } else if (best < knob.highest && knob.samples[best + 1] < SamplesPerValue) {
+        knob.current = best + 1;
+    } else {
+        knob.current = best;
+        return false;
+    }
+    return true;
+}
+
+void ConcurrencyTuner::run() {
+    std::size_t active = 0;
+    bool warmingUp = false;
+    std::uint64_t lastBytes = bytes.load(std::memory_order_relaxed);
+    std::uint64_t lastNs = nowNs();
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (active < knobs.size()) {
+        if (wake.wait_for(guard, Interval, [this] { return stopping; })) return;
+
+        std::uint64_t nowBytes = bytes.load(std::memory_order_relaxed);
+        std::uint64_t now = nowNs();
+        double rate = now > lastNs ? double(nowBytes - lastBytes) * 1e9 / double(now - lastNs) : 0.0;
+        lastBytes = nowBytes;
+        lastNs = now;
+        if (warmingUp) {
+            warmingUp = false;
+            continue;
+        }
+
+        Knob& knob = knobs[active];
+        std::size_t before = knob.current;
+        bool climbing = climb(knob, rate);
+        if (knob.best != 0) bestBytesPerSecond = static_cast<std::uint64_t>(knob.rates[knob.best]);
+        if (!climbing) {
+            active++;
+            settled = active == knobs.size();
+        }
+        if (knob.current == before) continue;
+        changes++;
+        warmingUp = true;
+        std::size_t value = knob.current;
+        guard.unlock();
+        knob.apply(value);
+        guard.lock();
+    }
+    // Everything holds its best value until the batch ends
+}
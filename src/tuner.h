@@ -0,0 +1,80 @@
+// Finds how many workers should read at once (--tune).
+//
+// The right number depends on the disks, the page cache and on how much of
+// the CPUs a container really gets, none of which a thread count picked in
+// advance knows. The tuner samples bytes hashed per interval and climbs:
+// from the starting setting it tries the neighbours of the best one seen so
+// far, one step at a time, until the best setting beats both of its
+// neighbours. It first climbs on the busy worker count, then on the reads
+// allowed at a time on each disk, and then holds what it found.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+class ConcurrencyTuner {
+    public:
+    // 'bytes' is the counter readers add to (ReadContext::progress).
+    // 'apply' sets the number of busy workers, between 1 and 'workers', and
+    // is first called with 'workers'. With a 'depth' above 0, 'applyDepth'
+    // then sets the reads allowed at a time per disk, between 1 and
+    // 'workers', starting from 'depth'.
+    ConcurrencyTuner(const std::atomic<std::uint64_t>& bytes, std::size_t workers, std::function<void(std::size_t)> apply,
+                     std::size_t depth = 0, std::function<void(std::size_t)> applyDepth = nullptr);
+    ~ConcurrencyTuner();
+
+    ConcurrencyTuner(const ConcurrencyTuner&) = delete;
+    ConcurrencyTuner& operator=(const ConcurrencyTuner&) = delete;
+
+    // Stop climbing. Afterwards the results below no longer change.
+    void stop();
+
+    // The worker count that gave the best throughput, and that throughput
+    // in bytes per second; 0 if no interval was completed
+    std::size_t bestWorkers();
+    std::uint64_t bestRate();
+    // The per-disk read limit it settled on, 0 when that was not tuned
+    std::size_t bestDepth();
+    // Times a setting was changed
+    std::size_t steps();
+    // True once every setting holds its best value
+    bool converged();
+
+    private:
+    // One setting to climb on, from 1 to 'highest'
+    struct Knob {
+        std::size_t highest = 1;
+        std::size_t current = 1;
+        std::size_t best = 0;
+        std::function<void(std::size_t)> apply;
+        // Mean rate and sample count by value
+        std::vector<double> rates;
+        std::vector<unsigned> samples;
+    };
+
+    void run();
+    // Account one interval to the knob's current value and pick the next
+    // value. Returns false once the knob holds its best value.
+    bool climb(Knob& knob, double rate);
+
+    const std::atomic<std::uint64_t>& bytes;
+    std::vector<Knob> knobs;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::uint64_t bestBytesPerSecond = 0;
+    std::size_t changes = 0;
+    bool settled = false;
+    std::thread thread;
+};
+
+// One "itfl: " line on what the tuner settled on, out of 'workers'
+void printTuning(std::ostream& out, ConcurrencyTuner& tuner, std::size_t workers);
@@ -0,0 +1,92 @@
+#include "walk.h"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+std::vector<WalkEntry> walkTrees(const std::vector<std::string>& roots, std::vector<std::string>& errors) {
+    std::vector<WalkEntry> entries;
+    // Directories still to list. One iterator per directory, so a directory
+    // that cannot be read only loses its own subtree.
+    std::vector<fs::path> pending;
+
+    for (const std::string& root : roots) {
+        std::error_code error;
+        fs::file_status status = fs::symlink_status(root, error);
+        if (error) {
+            errors.push_back(root + ": " + error.message());
+        } else if (fs::is_regular_file(status)) {
+            std::uint64_t size = fs::file_size(root, error);
+            if (!error) entries.push_back({root, size});
+        } else if (fs::is_directory(status)) {
+            pending.push_back(root);
+        }
+    }
+
+    while (!pending.empty()) {
+        fs::path directory = std::move(pending.back());
+        pending.pop_back();
+
+        std::error_code error;
+        fs::directory_iterator it(directory, error);
+        for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+            std::error_code statError;
+            fs::file_status status = it->symlink_status(statError);
+            if (statError) continue;
+            if (fs::is_directory(status)) {
+                pending.push_back(it->path());
+            } else if (fs::is_regular_file(status)) {
+                std::uint64_t size = it->file_size(statError);
+                if (!statError) entries.push_back({it->path().string(), size});
+            }
+        }
+        if (error) errors.push_back(directory.string() + ": " + error.message());
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const WalkEntry& a, const WalkEntry& b) { return a.path < b.path; });
+    return entries;
+}
+
+TreeWalker::TreeWalker(const std::string& root, std::vector<std::string>& errors) : errors(errors) {
+    enter(root);
+}
+
+void TreeWalker::enter(const fs::path& directory) {
+    Level level;
+    level.directory = directory;
+    std::error_code error;
+    fs::directory_iterator it(directory, error);
+    for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+        std::error_code statError;
+        fs::file_status status = it->symlink_status(statError);
+        if (statError) continue;
+        if (fs::is_directory(status)) {
+            level.names.push_back(it->path().filename().string() + '/');
+        } else if (fs::is_regular_file(status)) {
+            level.names.push_back(it->path().filename().string());
+        }
+    }
+    if (error) errors.push_back(directory.string() + ": " + error.message());
+    std::sort(level.names.begin(), level.names.end());
+    levels.push_back(std::move(level));
+}
+
+bool TreeWalker::next(std::string& path) {
+    while (!levels.empty()) {
+        Level& level = levels.back();
+        if (level.position == level.names.size()) {
+            levels.pop_back();
+            continue;
+        }
+        const std::string& name = level.names[level.position++];
+        if (name.back() == '/') {
+            // Invalidates 'level'
+            enter(level.directory / name.substr(0, name.size() - 1));
+            continue;
+        }
+        path = (level.directory / name).string();
+        return true;
+    }
+    return false;
+}
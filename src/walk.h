@@ -0,0 +1,44 @@
+// Collect the files under directory trees
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct WalkEntry {
+    std::string path;
+    std::uint64_t size = 0;
+};
+
+// Regular files under every root, or the root itself if it is a file,
+// sorted by path. Symlinks are not followed. Roots and directories that
+// cannot be read are listed in 'errors' and skipped.
+std::vector<WalkEntry> walkTrees(const std::vector<std::string>& roots, std::vector<std::string>& errors);
+
+// The regular files under one directory in the same order, but listed as
+// the walk gets to them: it holds one sorted listing per level of the
+// current path instead of the whole tree. Directories that cannot be read
+// are added to 'errors' when they are reached.
+class TreeWalker {
+    public:
+    TreeWalker(const std::string& root, std::vector<std::string>& errors);
+
+    // The next file, false at the end
+    bool next(std::string& path);
+
+    private:
+    struct Level {
+        std::filesystem::path directory;
+        // Names of files, and of directories with a '/' appended, which
+        // sorts them where their contents go in path order
+        std::vector<std::string> names;
+        std::size_t position = 0;
+    };
+
+    void enter(const std::filesystem::path& directory);
+
+    std::vector<std::string>& errors;
+    std::vector<Level> levels;
+};
@@ -0,0 +1,280 @@
+// itfl watch: hash directory trees once, then keep the digests current by
+// rehashing only the files the kernel reports as changed, and print every
+// change. The cost after the first pass follows the churn, not the size of
+// the trees.
+#include "../lib/cxxopts.hpp"
+#include "commands.h"
+#include "digest.h"
+#include "manifest.h"
+#include "options.h"
+#include "pool.h"
+#include "progress.h"
+#include "term.h"
+#include "walk.h"
+#include "watcher.h"
+
+#include <algorithm>
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+struct Tracked {
+    std::string sha256;
+    std::uint64_t size = 0;
+};
+
+// When a path saw its first and its latest event since it was last hashed
+struct Pending {
+    std::uint64_t firstNs = 0;
+    std::uint64_t lastNs = 0;
+};
+
+// A file written without pause is still hashed this many debounce
+// intervals after its first event
+constexpr std::uint64_t MaxDelayIntervals = 10;
+
+// One change line. A path that would break the line is escaped the way a
+// manifest line is, with a leading backslash, as in 'itfl diff'.
+void printChange(const char* change, const std::string& sha256, const std::string& path) {
+    if (manifestPathNeedsEscape(path)) {
+        std::cout << '\\' << change << ' ' << sha256 << "  " << escapeManifestPath(path) << '\n';
+    } else {
+        std::cout << change << ' ' << sha256 << "  " << path << '\n';
+    }
+}
+
+} // namespace
+
+int runWatch(int argc, char* argv[]) {
+    cxxopts::Options options("itfl watch", "Keep the digests of directory trees current and print every change\n\nUsage:\n itfl watch [OPTIONS] <dirs...>\n\nPrints 'added', 'modified' or 'removed', the SHA-256 and the path of each change, until interrupted.");
+    options.add_options()
+        ("debounce", "Milliseconds a file must be left alone before it is rehashed", cxxopts::value<unsigned>()->default_value("500"))
+        ("no-fanotify", "Use inotify even where fanotify is permitted")
+        ("paths", "Directories to watch", cxxopts::value<std::vector<std::string>>())
+        ("help", "Print usage");
+    addCommonOptions(options);
+    options.parse_positional({"paths"});
+    auto result = options.parse(argc, argv);
+
+    const TerminalColor color;
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("paths") == 0) {
+        std::cerr << color.red << "Error: " << color.reset << "No directories given. \n\n" << options.help() << std::endl;
+        return 1;
+    }
+
+    CommonOptions common;
+    if (!parseCommonOptions(result, common)) {
+        return 1;
+    }
+    IoStats stats;
+    if (common.statsFormat != StatsFormat::None) {
+        common.read.stats = &stats;
+    }
+    const RunTimer timer;
+    const std::uint64_t debounceNs = std::uint64_t(result["debounce"].as<unsigned>()) * 1000000;
+    // "dir/" and "dir" are one root, and what is under it is "dir/..."
+    std::vector<std::string> roots = result["paths"].as<std::vector<std::string>>();
+    for (std::string& root : roots) {
+        while (root.size() > 1 && root.back() == '/') root.pop_back();
+    }
+
+    // Subscribe before the first pass, so nothing written during it is missed
+    ChangeWatcher watcher(roots, result.count("no-fanotify") == 0);
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    WorkerPool pool(common.jobs, common.topology);
+    std::vector<IoStats> workerStats(pool.size());
+    std::map<std::string, Tracked> table;
+    std::uint64_t rehashedFiles = 0, rehashedBytes = 0;
+
+    // Hash 'paths' on the pool. Files that fail are left out of 'digests', and
+    // so are the ones not started before an interrupt.
+    auto hashAll = [&](const std::vector<std::string>& paths, ProgressCounters* counters) {
+        std::vector<FileDigests> digests(paths.size());
+        std::vector<char> ok(paths.size(), 0);
+        pool.parallelFor(paths.size(), [&](std::size_t i, Worker& worker) {
+            if (stopRequested) return;
+            ReadContext ctx = common.read;
+            ctx.node = worker.node;
+            if (ctx.stats) ctx.stats = &workerStats[worker.index];
+            ok[i] = digestFile(paths[i], DigestRequest(), ctx, digests[i]);
+            if (counters) counters->files.fetch_add(1, std::memory_order_relaxed);
+        });
+        std::map<std::string, FileDigests> hashed;
+        for (std::size_t i = 0; i < paths.size(); i++) {
+            if (ok[i]) hashed.emplace(paths[i], std::move(digests[i]));
+        }
+        return hashed;
+    };
+
+    // First pass: everything
+    {
+        std::vector<std::string> errors;
+        std::vector<WalkEntry> files = walkTrees(roots, errors);
+        for (const std::string& error : errors) std::cerr << color.red << "Error: " << color.reset << error << "\n";
+
+        ProgressCounters counters;
+        std::unique_ptr<ProgressReporter> reporter;
+        std::uint64_t totalBytes = 0;
+        for (const WalkEntry& file : files) totalBytes += file.size;
+        if (common.progress) {
+            common.read.progress = &counters.bytes;
+            reporter = std::make_unique<ProgressReporter>(counters, totalBytes, files.size());
+        }
+        std::vector<std::string> paths;
+        for (const WalkEntry& file : files) paths.push_back(file.path);
+        std::map<std::string, FileDigests> hashed = hashAll(paths, &counters);
+        for (const WalkEntry& file : files) {
+            auto found = hashed.find(file.path);
+            if (found != hashed.end()) table[file.path] = {found->second.sha256, file.size};
+        }
+        reporter.reset();
+        common.read.progress = nullptr;
+        if (stopRequested) {
+            std::cerr << "itfl: interrupted, " << table.size() << " of " << files.size() << " files hashed\n";
+        } else {
+            std::cerr << "itfl: watching " << table.size() << " files, " << totalBytes << " bytes, with " << watcher.backend() << '\n';
+        }
+    }
+
+    std::map<std::string, Pending> pending;
+    std::size_t batches = 0;
+    while (!stopRequested) {
+        // Sleep until the earliest pending path is due, or for a while when idle
+        std::uint64_t now = nowNs();
+        int timeoutMs = 1000;
+        for (const auto& entry : pending) {
+            std::uint64_t due = std::min(entry.second.lastNs + debounceNs, entry.second.firstNs + MaxDelayIntervals * debounceNs);
+            int waitMs = due > now ? static_cast<int>((due - now + 999999) / 1000000) : 0;
+            timeoutMs = std::min(timeoutMs, waitMs);
+        }
+        std::vector<std::string> changed;
+        bool overflow = false;
+        watcher.wait(timeoutMs, changed, overflow);
+
+        now = nowNs();
+        if (overflow) {
+            // Events were lost: only looking at everything again can tell what changed
+            std::cerr << "itfl: event queue overflowed, rescanning\n";
+            changed.insert(changed.end(), roots.begin(), roots.end());
+        }
+        for (std::string& path : changed) {
+            Pending& entry = pending[path];
+            if (entry.firstNs == 0) entry.firstNs = now;
+            entry.lastNs = now;
+        }
+
+        std::vector<std::string> due;
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (now - it->second.lastNs >= debounceNs || now - it->second.firstNs >= MaxDelayIntervals * debounceNs) {
+                due.push_back(it->first);
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (due.empty()) continue;
+        batches++;
+
+        // Find out what each path is now. Directories that appeared are
+        // walked, and whatever the table had under a path that is gone, or
+        // is no longer there after the walk, was removed.
+        std::set<std::string> toHash, present;
+        std::vector<std::string> removed;
+        auto removeUnder = [&](const std::string& path, bool keepPresent) {
+            auto it = table.lower_bound(path);
+            while (it != table.end() && it->first.compare(0, path.size(), path) == 0) {
+                bool inside = it->first.size() == path.size() || path.back() == '/' || it->first[path.size()] == '/';
+                if (inside && !(keepPresent && present.count(it->first))) removed.push_back(it->first);
+                ++it;
+            }
+        };
+        for (const std::string& path : due) {
+            std::error_code error;
+            fs::file_status status = fs::symlink_status(path, error);
+            if (error || !fs::exists(status)) {
+                removeUnder(path, false);
+            } else if (fs::is_directory(status)) {
+                watcher.watchTree(path);
+                std::vector<std::string> errors;
+                for (WalkEntry& file : walkTrees({path}, errors)) {
+                    present.insert(file.path);
+                    toHash.insert(std::move(file.path));
+                }
+                for (const std::string& walkError : errors) std::cerr << color.red << "Error: " << color.reset << walkError << "\n";
+                removeUnder(path, true);
+            } else if (fs::is_regular_file(status)) {
+                toHash.insert(path);
+            } else {
+                removeUnder(path, false);
+            }
+        }
+
+        std::vector<std::string> paths(toHash.begin(), toHash.end());
+        std::map<std::string, FileDigests> hashed = hashAll(paths, nullptr);
+        // Files skipped by the interrupt are not gone
+        if (stopRequested) break;
+        for (const std::string& path : paths) {
+            auto found = hashed.find(path);
+            // Gone again before it could be read
+            if (found == hashed.end()) {
+                if (table.count(path)) removed.push_back(path);
+                continue;
+            }
+            std::error_code error;
+            std::uint64_t size = fs::file_size(path, error);
+            if (error) size = 0;
+            rehashedFiles++;
+            rehashedBytes += size;
+            auto tracked = table.find(path);
+            if (tracked == table.end()) {
+                printChange("added", found->second.sha256, path);
+                table[path] = {found->second.sha256, size};
+            } else if (tracked->second.sha256 != found->second.sha256) {
+                printChange("modified", found->second.sha256, path);
+                tracked->second = {found->second.sha256, size};
+            } else {
+                tracked->second.size = size;
+            }
+        }
+        std::sort(removed.begin(), removed.end());
+        removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+        for (const std::string& path : removed) {
+            auto tracked = table.find(path);
+            if (tracked == table.end()) continue;
+            printChange("removed", tracked->second.sha256, path);
+            table.erase(tracked);
+        }
+        std::cout.flush();
+    }
+
+    for (const IoStats& workerStat : workerStats) stats.merge(workerStat);
+    printStats(std::cerr, stats, timer.elapsedNs(), common.statsFormat);
+    std::uint64_t trackedBytes = 0;
+    for (const auto& entry : table) trackedBytes += entry.second.size;
+    std::cerr << "itfl: " << batches << " batch(es) of changes, rehashed " << rehashedFiles << " files, "
+              << rehashedBytes << " bytes; tracking " << table.size() << " files, " << trackedBytes << " bytes\n";
+    return 0;
+}
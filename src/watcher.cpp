@@ -0,0 +1,232 @@
+#include "watcher.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+#ifdef __linux__
+constexpr std::uint32_t InotifyMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+constexpr std::uint64_t FanotifyMask = FAN_CLOSE_WRITE | FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_ONDIR;
+#endif
+
+std::string join(const std::string& directory, const std::string& name) {
+    if (!directory.empty() && directory.back() == '/') return directory + name;
+    return directory + "/" + name;
+}
+
+// "dir/" and "dir" are the same root; walkTrees spells what is under both as "dir/..."
+std::string trimSlashes(std::string path) {
+    while (path.size() > 1 && path.back() == '/') path.pop_back();
+    return path;
+}
+
+} // namespace
+
+ChangeWatcher::ChangeWatcher(const std::vector<std::string>& rootPaths, bool fanotify) {
+#ifdef __linux__
+    for (const std::string& root : rootPaths) {
+        std::error_code error;
+        fs::path canonical = fs::canonical(root, error);
+        if (error) throw std::runtime_error("cannot watch '" + root + "': " + error.message());
+        roots.emplace_back(canonical.string(), trimSlashes(root));
+    }
+
+    if (fanotify) {
+        // Reports the parent directory's handle and the name, for every kind of event
+        fanotifyFd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_CLOEXEC);
+        for (std::size_t i = 0; fanotifyFd >= 0 && i < roots.size(); i++) {
+            int fd = ::open(roots[i].first.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            struct statfs fs;
+            bool known = fd >= 0 && ::fstatfs(fd, &fs) == 0;
+            if (known) {
+                static_assert(sizeof(fs.f_fsid) == sizeof(std::uint64_t), "fsid is two 32-bit words");
+                MountFd mount;
+                std::memcpy(&mount.fsid, &fs.f_fsid, sizeof(mount.fsid));
+                mount.fd = fd;
+                mountFds.push_back(mount);
+            } else if (fd >= 0) {
+                ::close(fd);
+            }
+            if (!known || fanotify_mark(fanotifyFd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FanotifyMask, AT_FDCWD, roots[i].first.c_str()) != 0) {
+                // Not permitted, or not supported here: fall back for all roots
+                ::close(fanotifyFd);
+                fanotifyFd = -1;
+            }
+        }
+        if (fanotifyFd >= 0) return;
+        for (const MountFd& mount : mountFds) ::close(mount.fd);
+        mountFds.clear();
+    }
+
+    inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotifyFd < 0) throw std::runtime_error("cannot start inotify: " + std::string(std::strerror(errno)));
+    for (const auto& root : roots) watchTree(root.second);
+#else
+    (void)rootPaths;
+    (void)fanotify;
+    throw std::runtime_error("watching needs fanotify or inotify (Linux)");
+#endif
+}
+
+ChangeWatcher::~ChangeWatcher() {
+#ifdef __linux__
+    for (const MountFd& mount : mountFds) ::close(mount.fd);
+    if (fanotifyFd >= 0) ::close(fanotifyFd);
+    if (inotifyFd >= 0) ::close(inotifyFd);
+#endif
+}
+
+void ChangeWatcher::watchTree(const std::string& directory) {
+#ifdef __linux__
+    if (inotifyFd < 0) return;
+    std::vector<std::string> pending{directory};
+    while (!pending.empty()) {
+        std::string current = std::move(pending.back());
+        pending.pop_back();
+        // A directory moved within the tree keeps its watch; this renames it
+        int wd = inotify_add_watch(inotifyFd, current.c_str(), InotifyMask | IN_ONLYDIR);
+        if (wd < 0) {
+            if (errno == ENOSPC) throw std::runtime_error("out of inotify watches (see /proc/sys/fs/inotify/max_user_watches)");
+            continue;
+        }
+        directories[wd] = current;
+
+        std::error_code error;
+        fs::directory_iterator it(current, error);
+        for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+            std::error_code statError;
+            if (fs::is_directory(it->symlink_status(statError)) && !statError) pending.push_back(it->path().string());
+        }
+    }
+#else
+    (void)directory;
+#endif
+}
+
+bool ChangeWatcher::underRoot(const std::string& path, std::string& spelled) const {
+    for (const auto& root : roots) {
+        const std::string& canonical = root.first;
+        if (path == canonical) {
+            spelled = root.second;
+            return true;
+        }
+        std::string prefix = canonical == "/" ? canonical : canonical + "/";
+        if (path.compare(0, prefix.size(), prefix) == 0) {
+            spelled = join(root.second, path.substr(prefix.size()));
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChangeWatcher::wait(int timeoutMs, std::vector<std::string>& paths, bool& overflow) {
+#ifdef __linux__
+    pollfd pfd;
+    pfd.fd = fanotifyFd >= 0 ? fanotifyFd : inotifyFd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeoutMs) <= 0) return;
+    if (fanotifyFd >= 0) {
+        readFanotify(paths, overflow);
+    } else {
+        readInotify(paths, overflow);
+    }
+#else
+    (void)timeoutMs;
+    (void)paths;
+    (void)overflow;
+#endif
+}
+
+void ChangeWatcher::readFanotify(std::vector<std::string>& paths, bool& overflow) {
+#ifdef __linux__
+    alignas(fanotify_event_metadata) char buf[64 * 1024];
+    ssize_t got;
+    while ((got = ::read(fanotifyFd, buf, sizeof(buf))) > 0) {
+        const fanotify_event_metadata* event = reinterpret_cast<const fanotify_event_metadata*>(buf);
+        for (; FAN_EVENT_OK(event, got); event = FAN_EVENT_NEXT(event, got)) {
+            if (event->mask & FAN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            const char* info = reinterpret_cast<const char*>(event + 1);
+            const char* end = reinterpret_cast<const char*>(event) + event->event_len;
+            while (info + sizeof(fanotify_event_info_header) <= end) {
+                const fanotify_event_info_fid* fid = reinterpret_cast<const fanotify_event_info_fid*>(info);
+                if (fid->hdr.len == 0) break;
+                if (fid->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                    // The handle names the directory, the entry name follows it
+                    file_handle* handle = reinterpret_cast<file_handle*>(const_cast<unsigned char*>(fid->handle));
+                    const char* name = reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes);
+                    // The handle is only valid on its own filesystem: decode it
+                    // through the roots on the filesystem the event names
+                    std::uint64_t fsid;
+                    static_assert(sizeof(fid->fsid) == sizeof(fsid), "fsid is two 32-bit words");
+                    std::memcpy(&fsid, &fid->fsid, sizeof(fsid));
+                    for (const MountFd& mount : mountFds) {
+                        if (mount.fsid != fsid) continue;
+                        int dirFd = open_by_handle_at(mount.fd, handle, O_PATH | O_CLOEXEC);
+                        if (dirFd < 0) continue;
+                        char target[PATH_MAX];
+                        ssize_t length = readlink(("/proc/self/fd/" + std::to_string(dirFd)).c_str(), target, sizeof(target) - 1);
+                        ::close(dirFd);
+                        std::string spelled;
+                        // Another root on the same filesystem may be the one it is under
+                        if (length > 0 && underRoot(join(std::string(target, static_cast<std::size_t>(length)), name), spelled)) {
+                            paths.push_back(std::move(spelled));
+                            break;
+                        }
+                    }
+                }
+                info += fid->hdr.len;
+            }
+        }
+    }
+#else
+    (void)paths;
+    (void)overflow;
+#endif
+}
+
+void ChangeWatcher::readInotify(std::vector<std::string>& paths, bool& overflow) {
+#ifdef __linux__
+    alignas(inotify_event) char buf[64 * 1024];
+    ssize_t got;
+    while ((got = ::read(inotifyFd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + got;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            auto directory = directories.find(event->wd);
+            if (directory == directories.end()) continue;
+            if (event->mask & IN_IGNORED) {
+                // The directory is gone, its parent reported that
+                directories.erase(directory);
+                continue;
+            }
+            if (event->len > 0) paths.push_back(join(directory->second, event->name));
+        }
+    }
+#else
+    (void)paths;
+    (void)overflow;
+#endif
+}
@@ -0,0 +1,60 @@
+// Change notification for itfl watch: which paths under the watched roots
+// may have changed since the last call.
+//
+// fanotify with a filesystem mark sees every file on the filesystem with a
+// single mark, however many directories there are, but needs CAP_SYS_ADMIN.
+// Without it, inotify watches every directory separately and new
+// directories have to be added as they appear (see watchTree). Either way
+// the watcher only names paths; what happened to them is found out by
+// looking, once the events have settled.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ChangeWatcher {
+    public:
+    // Watch every directory under 'roots'. Tries fanotify first when
+    // 'fanotify' is set. Throws std::runtime_error if neither works.
+    ChangeWatcher(const std::vector<std::string>& roots, bool fanotify);
+    ~ChangeWatcher();
+
+    ChangeWatcher(const ChangeWatcher&) = delete;
+    ChangeWatcher& operator=(const ChangeWatcher&) = delete;
+
+    // "fanotify" or "inotify"
+    const char* backend() const { return fanotifyFd >= 0 ? "fanotify" : "inotify"; }
+
+    // A directory appeared under a root, or was moved there. inotify has to
+    // be told; fanotify already sees it.
+    void watchTree(const std::string& directory);
+
+    // Wait up to timeoutMs for events and append the paths they name, as
+    // they would be spelled under the roots given to the constructor. Sets
+    // 'overflow' if the kernel dropped events, after which only a full
+    // rescan can tell what changed. Returns early on a signal.
+    void wait(int timeoutMs, std::vector<std::string>& paths, bool& overflow);
+
+    private:
+    void readFanotify(std::vector<std::string>& paths, bool& overflow);
+    void readInotify(std::vector<std::string>& paths, bool& overflow);
+    // Map a path from the kernel back under the root it was found in
+    bool underRoot(const std::string& path, std::string& spelled) const;
+
+    int fanotifyFd = -1;
+    int inotifyFd = -1;
+    // Directory fd per root and the id of its filesystem (f_fsid), needed
+    // to resolve fanotify's file handles
+    struct MountFd {
+        std::uint64_t fsid;
+        int fd;
+    };
+    std::vector<MountFd> mountFds;
+    // (canonical root, root as given)
+    std::vector<std::pair<std::string, std::string>> roots;
+    // inotify watch descriptor to directory
+    std::unordered_map<int, std::string> directories;
+};
@@ -0,0 +1,201 @@
+// Known-answer and round-trip checks for the pieces every manifest goes
+// through: the CRC-32C, path escaping, and text <-> binary conversion.
+//
+// Usage: itfl_tests <group>, one of crc32c, escape, convert. ctest runs
+// each group as its own test.
+#include "../lib/crc32c.h"
+#include "../src/binmanifest.h"
+#include "../src/manifest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                         \
+    do {                                                                                         \
+        if (!(condition)) {                                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #condition << '\n'; \
+            failures++;                                                                          \
+        }                                                                                        \
+    } while (0)
+
+#define CHECK_EQUAL(actual, expected)                                                                            \
+    do {                                                                                                         \
+        const auto& actualValue = (actual);                                                                      \
+        const auto& expectedValue = (expected);                                                                  \
+        if (!(actualValue == expectedValue)) {                                                                   \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is '" << actualValue << "', expected '" \
+                      << expectedValue << "'\n";                                                                 \
+            failures++;                                                                                          \
+        }                                                                                                        \
+    } while (0)
+
+std::string crc32cOf(const void* data, std::size_t size) {
+    CRC32C crc32c;
+    return crc32c(data, size);
+}
+
+// A file in the temporary directory, removed again on destruction
+class TempFile {
+    public:
+    explicit TempFile(const std::string& name)
+        : path((std::filesystem::temp_directory_path() / ("itfl_tests_" + std::to_string(::getpid()) + "_" + name)).string()) {}
+    ~TempFile() { std::remove(path.c_str()); }
+
+    const std::string path;
+};
+
+void testCrc32c() {
+    // RFC 3720 B.4 and the usual check value
+    CHECK_EQUAL(crc32cOf("123456789", 9), std::string("e3069283"));
+    CHECK_EQUAL(crc32cOf("", 0), std::string("00000000"));
+    unsigned char block[32];
+    std::memset(block, 0, sizeof(block));
+    CHECK_EQUAL(crc32cOf(block, sizeof(block)), std::string("8a9136aa"));
+    std::memset(block, 0xff, sizeof(block));
+    CHECK_EQUAL(crc32cOf(block, sizeof(block)), std::string("62a8ab43"));
+    for (int i = 0; i < 32; i++) block[i] = static_cast<unsigned char>(i);
+    CHECK_EQUAL(crc32cOf(block, sizeof(block)), std::string("46dd794e"));
+    for (int i = 0; i < 32; i++) block[i] = static_cast<unsigned char>(31 - i);
+    CHECK_EQUAL(crc32cOf(block, sizeof(block)), std::string("113fdb5c"));
+
+    // Any split, at any alignment, gives the one-shot result
+    std::vector<unsigned char> data(4099);
+    std::uint32_t state = 12345;
+    for (unsigned char& byte : data) {
+        state = state * 1103515245 + 12345;
+        byte = static_cast<unsigned char>(state >> 16);
+    }
+    const std::string whole = crc32cOf(data.data(), data.size());
+    for (std::size_t step : {1, 3, 7, 8, 13, 64, 1000}) {
+        CRC32C crc32c;
+        for (std::size_t offset = 0; offset < data.size(); offset += step) {
+            crc32c.add(data.data() + offset, std::min(step, data.size() - offset));
+        }
+        CHECK_EQUAL(crc32c.getHash(), whole);
+    }
+
+    // The bytes form is the hex form, big endian
+    CRC32C crc32c;
+    crc32c.add("123456789", 9);
+    unsigned char raw[CRC32C::HashBytes];
+    crc32c.getHash(raw);
+    CHECK(raw[0] == 0xe3 && raw[1] == 0x06 && raw[2] == 0x92 && raw[3] == 0x83);
+}
+
+void testEscape() {
+    CHECK(!manifestPathNeedsEscape("plain/path with spaces"));
+    CHECK(manifestPathNeedsEscape("back\\slash"));
+    CHECK(manifestPathNeedsEscape("new\nline"));
+    CHECK(manifestPathNeedsEscape("carriage\rreturn"));
+    CHECK_EQUAL(escapeManifestPath("a\\b\nc\rd"), std::string("a\\\\b\\nc\\rd"));
+
+    for (const std::string path : {"plain", "back\\slash", "new\nline", "\r\n\\", "trailing\\", "\\n literal"}) {
+        std::string escaped = escapeManifestPath(path);
+        CHECK(escaped.find('\n') == std::string::npos);
+        CHECK(escaped.find('\r') == std::string::npos);
+        CHECK(unescapeManifestPath(escaped));
+        CHECK_EQUAL(escaped, path);
+    }
+    std::string unknown = "bad\\x";
+    CHECK(!unescapeManifestPath(unknown));
+
+    // Through a whole line, as sha256sum writes it
+    ManifestEntry entry;
+    entry.path = "dir/new\nline\\name";
+    entry.sha256 = std::string(64, 'a');
+    std::ostringstream out;
+    writeManifestEntry(out, entry);
+    CHECK_EQUAL(out.str(), "\\" + entry.sha256 + "  dir/new\\nline\\\\name\n");
+    std::istringstream in(out.str());
+    std::vector<ManifestEntry> entries = readManifest(in);
+    CHECK(entries.size() == 1);
+    if (entries.size() == 1) CHECK_EQUAL(entries[0].path, entry.path);
+}
+
+bool sameEntry(const ManifestEntry& a, const ManifestEntry& b) {
+    return a.path == b.path && a.sha256 == b.sha256 && a.crc32c == b.crc32c && a.hasStat == b.hasStat
+        && a.size == b.size && a.mtimeNs == b.mtimeNs && a.binaryMode == b.binaryMode;
+}
+
+void testConvert() {
+    std::vector<ManifestEntry> entries(4);
+    entries[0].path = "a.txt";
+    entries[0].sha256 = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    entries[1].path = "sub/with crc";
+    entries[1].sha256 = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+    entries[1].crc32c = "e3069283";
+    entries[2].path = "odd\\name\nhere";
+    entries[2].sha256 = std::string(64, 'f');
+    entries[2].hasStat = true;
+    entries[2].size = 1234567890123ULL;
+    entries[2].mtimeNs = 1700000000123456789LL;
+    entries[3].path = "binary mode";
+    entries[3].sha256 = std::string(64, '0');
+    entries[3].binaryMode = true;
+
+    // Text, then binary, then text again
+    TempFile text("convert.sum"), binary("convert.bin");
+    {
+        std::ofstream out(text.path);
+        for (const ManifestEntry& entry : entries) writeManifestEntry(out, entry);
+    }
+    CHECK(!isBinaryManifest(text.path));
+    std::vector<ManifestEntry> fromText = loadManifest(text.path);
+    CHECK(fromText.size() == entries.size());
+    writeBinaryManifest(binary.path, fromText);
+    CHECK(isBinaryManifest(binary.path));
+    std::vector<ManifestEntry> fromBinary = loadManifest(binary.path);
+    CHECK(fromBinary.size() == entries.size());
+    for (std::size_t i = 0; i < entries.size() && i < fromText.size() && i < fromBinary.size(); i++) {
+        CHECK(sameEntry(fromText[i], entries[i]));
+        CHECK(sameEntry(fromBinary[i], entries[i]));
+    }
+
+    std::ostringstream again, original;
+    for (const ManifestEntry& entry : fromBinary) writeManifestEntry(again, entry);
+    for (const ManifestEntry& entry : entries) writeManifestEntry(original, entry);
+    CHECK_EQUAL(again.str(), original.str());
+
+    // Lookup by path in the binary form
+    const BinaryManifest manifest(binary.path);
+    CHECK(manifest.find("odd\\name\nhere") == std::vector<std::size_t>{2});
+    CHECK(manifest.find("missing").empty());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const std::string group = argc > 1 ? argv[1] : "";
+    try {
+        if (group == "crc32c") {
+            testCrc32c();
+        } else if (group == "escape") {
+            testEscape();
+        } else if (group == "convert") {
+            testConvert();
+        } else {
+            std::cerr << "Usage: itfl_tests crc32c|escape|convert\n";
+            return 2;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << group << ": unexpected exception: " << e.what() << '\n';
+        return 1;
+    }
+    if (failures > 0) {
+        std::cerr << group << ": " << failures << " check(s) failed\n";
+        return 1;
+    }
+    return 0;
+}